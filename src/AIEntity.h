@@ -6,8 +6,49 @@
 enum GameMessages {
 	// this ID is used for sending the AI entities
 	// the structure of the bitstream is:
-	// [ message ID, unsigned int bytecount, AIEntity array of size (bytecount / sizeof(AIEntity)) ]
+	// [ message ID, zero padding to 4 bytes, unsigned int bytecount, AIEntity array of size (bytecount / sizeof(AIEntity)) ]
+	// the padding keeps the array aligned so the client can read it in place (see EntityList)
 	ID_ENTITY_LIST = ID_USER_PACKET_ENUM + 1,
+
+	// the server sends the full wander state so a client can co-simulate the AI locally
+	// the structure of the bitstream is:
+	// [ message ID, unsigned int tick, float arenaRadius, unsigned int count,
+	//   count * ( AIEntity, float wanderAngle, unsigned int rngState ) ]
+	ID_SIMULATION_STATE,
+
+	// periodic checksum of the co-simulated state
+	// [ message ID, unsigned int tick, unsigned int checksum ]
+	ID_SIMULATION_CHECKSUM,
+
+	// sent by a co-simulating client when its checksum no longer matches the server's
+	// [ message ID ]
+	ID_SIMULATION_RESYNC,
+
+	// entities coded as residuals against the client's prediction from an acknowledged baseline
+	// the structure of the bitstream is (see SnapshotCodec):
+	// [ message ID, unsigned int tick, unsigned int baselineTick, unsigned int count,
+	//   count * ( varint id delta, varint teleported, varint px, py, vx, vy residuals ) ]
+	ID_ENTITY_RESIDUALS,
+
+	// the same residuals passed through the adaptive range coder (see RangeCoder)
+	// [ message ID, unsigned int tick, unsigned int baselineTick, unsigned int count,
+	//   unsigned int byteCount, range coded bytes ]
+	ID_ENTITY_RESIDUALS_RANGE,
+
+	// sent by the client for each snapshot it reconstructed, so the server can use it as a baseline
+	// a tick of SNAPSHOT_NO_BASELINE asks the server for a snapshot without a baseline
+	// [ message ID, unsigned int tick ]
+	ID_SNAPSHOT_ACK,
+
+	// sent by the client once connected, the server picks each connection's snapshot format from it
+	// [ message ID, unsigned int SnapshotCapabilities flags ]
+	ID_CLIENT_CAPABILITIES,
+
+	// entities that left or joined the simulation, sent reliably and in order since snapshots
+	// only update entities a client already knows about, a new client gets every entity as a spawn
+	// [ message ID, unsigned int tick, unsigned int despawnCount, despawnCount * unsigned int id,
+	//   unsigned int spawnCount, spawnCount * AIEntity ]
+	ID_ENTITY_EVENTS,
 };
 
 static const unsigned short SERVER_PORT = 5456;
@@ -32,7 +73,7 @@ struct AIVector {
 
 // basic AI entity data that is broadcast by the server
 struct AIEntity {
-	unsigned int id;
+	unsigned int id;	// generational handle from the server's SlotMap
 	AIVector position;
 	AIVector velocity;
 	bool teleported;
@@ -43,4 +84,5 @@ struct AIEntity {
 struct AIServerEntity {
 	AIEntity* data;
 	float wanderAngle;
+	unsigned int rngState;
 };
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "AIEntity.h"
+#include <cmath>
+
+// wander data, shared so that clients can co-simulate the server's AI
+// both applications must be built with the same toolset and floating point model
+// (/fp:precise) so that sinf / cosf and the float maths below produce identical bits
+static const float SIMULATION_TIMESTEP = 0.016666667f;
+static const float MAX_VELOCITY = 10;
+static const float WANDER_JITTER = 0.05f;
+static const float WANDER_OFFSET = 2.5f;
+static const float WANDER_RADIUS = 1.5f;
+
+// seeds an entity's random stream from the simulation seed and its id
+inline unsigned int wanderSeed(unsigned int seed, unsigned int id) {
+	unsigned int h = seed ^ (id * 0x9E3779B9u);
+	h ^= h >> 16; h *= 0x85EBCA6Bu;
+	h ^= h >> 13; h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	// xorshift can never leave a zero state
+	return h != 0 ? h : 0x6D2B79F5u;
+}
+
+// returns random range [0,1] and advances the entity's xorshift stream
+inline float wanderRandf(unsigned int& state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.0f / 16777215.0f);
+}
+
+// steps a single entity, this is the only place the wander motion is defined
+inline void updateWander(AIServerEntity& ai, float arenaRadius, float deltaTime) {
+
+	// jitter offset
+	ai.wanderAngle += (wanderRandf(ai.rngState) * 2 - 1) * WANDER_JITTER;
+
+	AIVector f = ai.data->velocity;
+	f.normalise();
+
+	// wander force
+	ai.data->velocity.x += sinf(ai.wanderAngle) * WANDER_RADIUS + f.x * WANDER_OFFSET;
+	ai.data->velocity.y += cosf(ai.wanderAngle) * WANDER_RADIUS + f.y * WANDER_OFFSET;
+
+	// truncate
+	if (ai.data->velocity.lengthSqr() > (MAX_VELOCITY * MAX_VELOCITY)) {
+		ai.data->velocity.normalise();
+		ai.data->velocity.x *= MAX_VELOCITY;
+		ai.data->velocity.y *= MAX_VELOCITY;
+	}
+
+	// move
+	ai.data->position.x += ai.data->velocity.x * deltaTime;
+	ai.data->position.y += ai.data->velocity.y * deltaTime;
+
+	ai.data->teleported = false;
+
+	// teleport if needed to stay in arena
+	if (ai.data->position.lengthSqr() > (arenaRadius * arenaRadius)) {
+		ai.data->teleported = true;
+		AIVector offset = ai.data->position;
+		offset.normalise();
+		ai.data->position.x -= offset.x * arenaRadius * 2;
+		ai.data->position.y -= offset.y * arenaRadius * 2;
+	}
+}
+
+// FNV-1a over the simulated bits, used to detect client / server divergence
+inline unsigned int wanderChecksum(const AIServerEntity* entities, size_t count) {
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < count; ++i) {
+		const float values[] = {
+			entities[i].data->position.x, entities[i].data->position.y,
+			entities[i].data->velocity.x, entities[i].data->velocity.y,
+			entities[i].wanderAngle };
+		const unsigned char* bytes = (const unsigned char*)values;
+		for (size_t b = 0; b < sizeof(values); ++b) {
+			hash ^= bytes[b];
+			hash *= 16777619u;
+		}
+		hash ^= entities[i].rngState;
+		hash *= 16777619u;
+	}
+	return hash;
+}
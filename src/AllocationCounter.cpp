@@ -0,0 +1,60 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef COUNT_ALLOCATIONS
+// constant initialised, so they're ready for allocations made before main
+static std::atomic<bool> counting(false);
+static std::atomic<unsigned int> allocations(0);
+
+static void* allocate(size_t a_size) {
+	if (counting.load(std::memory_order_relaxed))
+		allocations.fetch_add(1, std::memory_order_relaxed);
+
+	void* memory = malloc(a_size > 0 ? a_size : 1);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new(size_t a_size) {
+	return allocate(a_size);
+}
+
+void* operator new[](size_t a_size) {
+	return allocate(a_size);
+}
+
+void operator delete(void* a_memory) noexcept {
+	free(a_memory);
+}
+
+void operator delete[](void* a_memory) noexcept {
+	free(a_memory);
+}
+
+void AllocationCounter::setEnabled(bool a_enabled) {
+	allocations = 0;
+	counting = a_enabled;
+}
+
+bool AllocationCounter::isEnabled() {
+	return counting.load();
+}
+
+unsigned int AllocationCounter::take() {
+	return allocations.exchange(0);
+}
+#else
+void AllocationCounter::setEnabled(bool) {
+}
+
+bool AllocationCounter::isEnabled() {
+	return false;
+}
+
+unsigned int AllocationCounter::take() {
+	return 0;
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+// counts every operator new on every thread while enabled, by replacing the global operators,
+// so it's possible to see how much a frame allocates, while disabled a call costs one load and
+// a branch, so the operators are only replaced when COUNT_ALLOCATIONS is defined, and without
+// it nothing is ever counted, build the client with /p:CountAllocations=true to define it, in
+// Release for numbers that mean anything, Debug's checked iterators allocate differently
+class AllocationCounter {
+public:
+
+	// off until enabled
+	static void			setEnabled(bool a_enabled);
+	static bool			isEnabled();
+
+	// allocations since the last call, and starts counting again
+	static unsigned int	take();
+};
@@ -8,8 +8,11 @@
 #include <MessageIdentifiers.h>
 #include <BitStream.h>
 
+#include "AIWander.h"
 #include "Gizmos.h"
 #include "Camera.h"
+#include "Profiler.h"
+#include "AllocationCounter.h"
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -21,9 +24,23 @@ using glm::vec4;
 //The larger the smoothness the more data is taken from the delta of the new and old data
 const float AssessmentNetworkingApplication::smoothness = 0.8f;
 
+//Entities further than this from their filtered position have teleported
+const float AssessmentNetworkingApplication::teleportDistance = 45;
+
+//Above this the arrows are too small to tell apart
+const float AssessmentNetworkingApplication::densityCameraHeight = 150;
+
+// now when timing, otherwise 0, which millisecondsSince takes as nothing having been timed
+static long long startTimer(bool timing) {
+	return timing ? Profiler::now() : 0;
+}
+
+static float millisecondsSince(long long start) {
+	return start != 0 ? (Profiler::now() - start) / 1000000.0f : 0;
+}
+
 AssessmentNetworkingApplication::AssessmentNetworkingApplication() 
-: m_camera(nullptr),
-m_peerInterface(nullptr) {
+: m_camera(nullptr) {
 
 }
 
@@ -35,40 +52,73 @@ bool AssessmentNetworkingApplication::startup()
 {
 	m_packetTime = 0;
 	m_largestTick = 0;
-	m_skippedFrames = 0;
-
-	// setup the basic window
+	m_profileKeyDown = false;
+	m_traceKeyDown = false;
+	m_telemetryKeyDown = false;
+	m_overlayVisible = false;
+	m_overlayKeyDown = false;
+	m_overlaySample = PerformanceOverlay::Sample();
+	m_appliedTrace = LatencyTracer::Trace();
+	m_frameAcquired = false;
+
+	m_coSimulating = false;
+	m_coSimTick = 0;
+	m_coSimServerTick = 0;
+	m_coSimAccumulator = 0;
+	m_coSimArenaRadius = 0;
+	for (auto& entry : m_coSimChecksums)
+		entry.tick = entry.checksum = 0;
+	for (auto& entry : m_coSimServerChecksums)
+		entry.tick = entry.checksum = 0;
+
+	// setup the basic window, vsync paces the frames and the limit catches drivers that ignore it
+	// drawing happens on a thread of its own, while the next frame updates
+	setVSync(true);
+	setFrameRateLimit(144);
+	setRenderThread(true);
 	createWindow("Client Application", 1280, 720);
 
-	Gizmos::create();
+	Gizmos::create(0xffff, 0xffff, 0xff, 0xff, Gizmos::VERTEX_PACKED, true);
+	if (m_entityRenderer.create() == false ||
+		m_densityRenderer.create() == false ||
+		m_overlay.create() == false ||
+		m_latency.create() == false)
+		return false;
+
+	// the grid never changes, so it's uploaded once rather than added every frame
+	Gizmos::LineDesc grid[42];
+	for (int i = 0; i < 21; ++i) {
+		vec4 colour = i == 10 ? vec4(1, 1, 1, 1) : vec4(0, 0, 0, 1);
+		grid[i * 2] = { vec3(-10 + i, 0, 10), vec3(-10 + i, 0, -10), colour };
+		grid[i * 2 + 1] = { vec3(10, 0, -10 + i), vec3(-10, 0, -10 + i), colour };
+	}
+	Gizmos::beginStatic("grid");
+	Gizmos::addLines(grid, 42);
+	Gizmos::endStatic();
 
 	// set up basic camera
 	m_camera = new Camera(glm::pi<float>() * 0.25f, 16 / 9.f, 0.1f, 1000.f);
 	m_camera->setLookAtFrom(vec3(10, 10, 10), vec3(0));
+	Gizmos::setCamera(m_camera);
+	framebufferResized(getFramebufferWidth(), getFramebufferHeight());
 
-	// start client connection
-	m_peerInterface = RakNet::RakPeerInterface::GetInstance();
-	
-	RakNet::SocketDescriptor sd;
-	m_peerInterface->Startup(1, &sd, 1);
-
-	// request access to server
+	// start client connection, packets are received on the network thread from here on
 	std::string ipAddress = "localhost";
 	//std::cout << "Connecting to server at: ";
 	//std::cin >> ipAddress;
-	RakNet::ConnectionAttemptResult res = m_peerInterface->Connect(ipAddress.c_str(), SERVER_PORT, nullptr, 0);
-
-	if (res != RakNet::CONNECTION_ATTEMPT_STARTED) {
-		std::cout << "Unable to start connection, Error number: " << res << std::endl;
-		return false;
-	}
-
-	return true;
+	return m_network.startup(ipAddress.c_str(), SERVER_PORT);
 }
 
 void AssessmentNetworkingApplication::shutdown() {
+	// stop receiving before anything it hands over goes away
+	m_network.shutdown();
+
 	// delete our camera and cleanup gizmos
 	delete m_camera;
+	m_entityRenderer.destroy();
+	m_densityRenderer.destroy();
+	m_overlay.destroy();
+	m_latency.destroy();
 	Gizmos::destroy();
 
 	// destroy our window properly
@@ -83,170 +133,331 @@ bool AssessmentNetworkingApplication::update(float deltaTime)
 		glfwGetKey(m_window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		return false;
 
+	// F8 starts and stops recording zones, F9 writes what was recorded
+	bool profileKey = glfwGetKey(m_window, GLFW_KEY_F8) == GLFW_PRESS;
+	if (profileKey && m_profileKeyDown == false) {
+		Profiler::setEnabled(Profiler::isEnabled() == false);
+		std::cout << "Profiling " << (Profiler::isEnabled() ? "on" : "off") << std::endl;
+	}
+	m_profileKeyDown = profileKey;
+	bool traceKey = glfwGetKey(m_window, GLFW_KEY_F9) == GLFW_PRESS;
+	if (traceKey && m_traceKeyDown == false && Profiler::writeTrace("client_trace.json"))
+		std::cout << "Wrote the profile to client_trace.json" << std::endl;
+	m_traceKeyDown = traceKey;
+
+	// F10 writes the link telemetry kept so far
+	bool telemetryKey = glfwGetKey(m_window, GLFW_KEY_F10) == GLFW_PRESS;
+	if (telemetryKey && m_telemetryKeyDown == false && m_network.getTelemetry().writeCSV("client_telemetry.csv"))
+		std::cout << "Wrote the link telemetry to client_telemetry.csv" << std::endl;
+	m_telemetryKeyDown = telemetryKey;
+
+	// F3 shows and hides the performance overlay
+	bool overlayKey = glfwGetKey(m_window, GLFW_KEY_F3) == GLFW_PRESS;
+	if (overlayKey && m_overlayKeyDown == false) {
+		m_overlayVisible = m_overlayVisible == false;
+		m_overlaySample = PerformanceOverlay::Sample();
+		AllocationCounter::setEnabled(m_overlayVisible);
+	}
+	m_overlayKeyDown = overlayKey;
+	long long updateStart = startTimer(m_overlayVisible);
+
 	// update camera
 	m_camera->update(deltaTime);
 
-	// handle network messages
-	RakNet::Packet* packet;
-
+	long long gizmosStart = startTimer(m_overlayVisible);
 	Gizmos::clear();
+	m_overlaySample.gizmos += millisecondsSince(gizmosStart);
 
-	//Move AI to position clinet thinks they should be
-	for (int i = 0; i < m_aiEntities.size(); ++i)
-	{
-		AIEntity ai = m_aiTrueData[i];
-		ai.position.x += ai.velocity.x * 0.016666667f;
-		ai.position.y += ai.velocity.y * 0.016666667f;
+	long long filterStart = startTimer(m_overlayVisible);
 
-		ai.position = LowPass(m_aiLastFiltedFrame[i].position, ai.position, smoothness);
-		ai.velocity = LowPass(m_aiLastFiltedFrame[i].velocity, ai.velocity, smoothness);
+	//Co-simulating clients run the server's wander kernel themselves
+	if (m_coSimulating)
+	{
+		m_coSimAccumulator += deltaTime;
+		unsigned int catchUpSteps = 0;
+		while (m_coSimulating && m_coSimTick < m_coSimServerTick + MAX_SIMULATION_LEAD)
+		{
+			if (m_coSimAccumulator >= SIMULATION_TIMESTEP)
+				m_coSimAccumulator -= SIMULATION_TIMESTEP;
+			else if (m_coSimTick < m_coSimServerTick && catchUpSteps < MAX_CATCH_UP_STEPS)
+				++catchUpSteps;
+			else
+				break;
+			StepSimulation();
+		}
+		// don't bank time while held back, otherwise we would burst forward later
+		if (m_coSimAccumulator > SIMULATION_TIMESTEP)
+			m_coSimAccumulator = SIMULATION_TIMESTEP;
 
-		m_aiTrueData[i] = ai;
-		m_aiLastFiltedFrame[i] = ai;
+		m_entityState.load(m_coSimEntities.data(), m_coSimEntities.size());
 	}
+	else
+	{
+		//Move AI to position clinet thinks they should be
+		m_entityState.extrapolate(deltaTime, smoothness);
+	}
+	m_overlaySample.filter += millisecondsSince(filterStart);
 
-	//If packet is recived - data above will be overwritten
-	for (packet = m_peerInterface->Receive(); packet; m_peerInterface->DeallocatePacket(packet), packet = m_peerInterface->Receive()) 
+	// handle messages the network thread passed on
+	long long receiveStart = startTimer(m_overlayVisible);
+	for (RakNet::Packet* packet = m_network.receivePacket(); packet; m_network.releasePacket(packet), packet = m_network.receivePacket())
 	{
-		switch (packet->data[0]) 
+		switch (packet->data[0])
 		{
-		case ID_CONNECTION_REQUEST_ACCEPTED:
-			std::cout << "Our connection request has been accepted." << std::endl;
-			break;
-		case ID_CONNECTION_ATTEMPT_FAILED:
-			std::cout << "Our connection request failed!" << std::endl;
+		case ID_ENTITY_EVENTS:
+			ReceiveEntityEvents(packet);
 			break;
-		case ID_NO_FREE_INCOMING_CONNECTIONS:
-			std::cout << "The server is full." << std::endl;
+		case ID_SIMULATION_STATE:
+			ReceiveSimulationState(packet);
 			break;
-		case ID_DISCONNECTION_NOTIFICATION:
-			std::cout << "We have been disconnected." << std::endl;
+		case ID_SIMULATION_CHECKSUM:
+			ReceiveSimulationChecksum(packet);
 			break;
-		case ID_CONNECTION_LOST:
-			std::cout << "Connection lost." << std::endl;
-			break;
-		case ID_ENTITY_LIST: {
-
-			// receive list of entities
-			RakNet::BitStream stream(packet->data, packet->length, false);
-			stream.IgnoreBytes(sizeof(RakNet::MessageID));
-			unsigned int size = 0;
-			stream.Read(size);
-
-
-			// first time receiving entities
-			if (m_aiEntities.size() == 0) 
-			{
-				m_aiEntities.resize(size / sizeof(AIEntity));
-				m_aiTrueData.resize(size / sizeof(AIEntity));
-				m_aiLastFiltedFrame.resize(size / sizeof(AIEntity));
-				//Stream Data
-				stream.Read((char*)m_aiEntities.data(), size);
-				//Init variables
-				m_aiLastFiltedFrame = m_aiEntities;
-				m_largestTick = m_aiEntities[0].ticks;
-			}
-			else
-			{
-				//Stream Data
-				stream.Read((char*)m_aiEntities.data(), size);
-				//Filter out late packets by smoothing out movement
-				EntitySanityCheck();
-			}
-
-
-			break;
-		}
 		default:
-			std::cout << "Received unhandled message." << std::endl;
 			break;
 		}
-
 	}
+	m_overlaySample.receive += millisecondsSince(receiveStart);
 
-	// Add a grid
-	for (int i = 0; i < 21; ++i) {
-		Gizmos::addLine(vec3(-10 + i, 0, 10), vec3(-10 + i, 0, -10),
-						i == 10 ? vec4(1, 1, 1, 1) : vec4(0, 0, 0, 1));
-
-		Gizmos::addLine(vec3(10, 0, -10 + i), vec3(-10, 0, -10 + i),
-						i == 10 ? vec4(1, 1, 1, 1) : vec4(0, 0, 0, 1));
+	//If a snapshot was received - data above will be overwritten
+	//Only the newest is applied, any that arrived in between were dropped by the network thread
+	if (const ReceivedSnapshot* snapshot = m_network.acquireSnapshot())
+	{
+		filterStart = startTimer(m_overlayVisible);
+		EntitySanityCheck(*snapshot);
+		m_overlaySample.filter += millisecondsSince(filterStart);
+		++m_overlaySample.snapshots;
 	}
 
+	m_network.getTelemetry().update();
+
+	m_overlaySample.update += millisecondsSince(updateStart);
 	return true;
 }
 
-void AssessmentNetworkingApplication::EntitySanityCheck()
+void AssessmentNetworkingApplication::ReceiveEntityEvents(RakNet::Packet* packet)
 {
-	if (m_aiEntities[0].ticks >= m_largestTick)
-	{
-		//Make largest tick new tick
-		m_largestTick = m_aiEntities[0].ticks;
+	RakNet::BitStream stream(packet->data, packet->length, false);
+	stream.IgnoreBytes(sizeof(RakNet::MessageID));
+	unsigned int tick = 0, count = 0;
+	stream.Read(tick);
 
-		//Change all AI position to correct server data
-		for (int i = 0; i < m_aiEntities.size(); ++i)
-		{
-			AIEntity ai;
-			ai = m_aiEntities[i];
-
-			//If not teleported, lerp position with low pass
-			//Else, keep server data
-			if (std::abs(m_aiEntities[i].position.x - m_aiLastFiltedFrame[i].position.x) < 45 &&
-				std::abs(m_aiEntities[i].position.y - m_aiLastFiltedFrame[i].position.y) < 45)
-			{
-				ai.position = LowPass(m_aiLastFiltedFrame[i].position, m_aiEntities[i].position, smoothness);
-				ai.velocity = LowPass(m_aiLastFiltedFrame[i].velocity, m_aiEntities[i].velocity, smoothness);
-			}
-
-			m_aiTrueData[i] = ai;;
-		}
+	stream.Read(count);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		unsigned int id = 0;
+		if (stream.Read(id) == false)
+			return;
+		m_entityState.despawn(id);
+	}
 
-		m_aiLastFiltedFrame = m_aiTrueData;
+	count = 0;
+	stream.Read(count);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		AIEntity entity;
+		if (stream.Read((char*)&entity, sizeof(AIEntity)) == false)
+			return;
+		m_entityState.spawn(entity);
 	}
-	else //If late packet
+}
+
+void AssessmentNetworkingApplication::EntitySanityCheck(const ReceivedSnapshot& snapshot)
+{
+	PROFILE_SCOPE("EntitySanityCheck");
+
+	//The network thread discards late packets, so every tick here is the largest yet
+	m_largestTick = snapshot.tick;
+
+	//How far off the prediction was, before it's corrected
+	m_network.getTelemetry().corrections(m_entityState, snapshot.entities.data(), snapshot.entities.size());
+
+	//Change all AI position to correct server data
+	//If not teleported, lerp position with low pass
+	//Else, keep server data
+	m_entityState.filter(snapshot.entities.data(), snapshot.entities.size(), smoothness, teleportDistance);
+
+	m_appliedTrace = snapshot.trace;
+	m_appliedTrace.applied = LatencyTracer::now();
+}
+
+void AssessmentNetworkingApplication::ReceiveSimulationState(RakNet::Packet* packet)
+{
+	RakNet::BitStream stream(packet->data, packet->length, false);
+	stream.IgnoreBytes(sizeof(RakNet::MessageID));
+	unsigned int tick = 0, count = 0;
+	stream.Read(tick);
+	stream.Read(m_coSimArenaRadius);
+	stream.Read(count);
+
+	m_coSimEntities.resize(count);
+	m_coSimWander.resize(count);
+	for (unsigned int i = 0; i < count; ++i)
 	{
-		for (size_t i = 0; i < m_aiLastFiltedFrame.size(); i++)
-		{
-			AIEntity ai = m_aiLastFiltedFrame[i];
-			//Create new position guess
-			ai.position.x += ai.velocity.x * 0.016666667f;
-			ai.position.y += ai.velocity.y * 0.016666667f;
+		stream.Read((char*)&m_coSimEntities[i], sizeof(AIEntity));
+		stream.Read(m_coSimWander[i].wanderAngle);
+		stream.Read(m_coSimWander[i].rngState);
+		m_coSimWander[i].data = &m_coSimEntities[i];
+	}
 
-			//Lerp to new guessed position
-			ai.position = LowPass(m_aiLastFiltedFrame[i].position, ai.position, smoothness);
-			ai.velocity = LowPass(m_aiLastFiltedFrame[i].velocity, ai.velocity, smoothness);
+	// the state replaces anything we had simulated, so old checksums are meaningless
+	for (auto& entry : m_coSimChecksums)
+		entry.tick = entry.checksum = 0;
+	for (auto& entry : m_coSimServerChecksums)
+		entry.tick = entry.checksum = 0;
+	m_coSimServer = packet->systemAddress;
 
-			m_aiTrueData[i] = ai;
-		}
-		m_aiLastFiltedFrame = m_aiTrueData;
+	m_coSimTick = tick;
+	m_coSimServerTick = tick;
+	m_coSimAccumulator = 0;
+	m_coSimulating = true;
+
+	m_entityState.reset(m_coSimEntities.data(), m_coSimEntities.size());
+
+	std::cout << "Co-simulating " << count << " entities from tick " << tick << std::endl;
+}
+
+void AssessmentNetworkingApplication::ReceiveSimulationChecksum(RakNet::Packet* packet)
+{
+	if (m_coSimulating == false)
+		return;
+
+	RakNet::BitStream stream(packet->data, packet->length, false);
+	stream.IgnoreBytes(sizeof(RakNet::MessageID));
+	unsigned int tick = 0, checksum = 0;
+	stream.Read(tick);
+	stream.Read(checksum);
+
+	if (tick > m_coSimServerTick)
+		m_coSimServerTick = tick;
+
+	// if we're behind, update catches up and compares it when it steps to the tick
+	SimulationChecksum& entry = m_coSimServerChecksums[tick % CHECKSUM_HISTORY];
+	entry.tick = tick;
+	entry.checksum = checksum;
+	CompareSimulationChecksum(tick);
+}
+
+void AssessmentNetworkingApplication::CompareSimulationChecksum(unsigned int tick)
+{
+	const SimulationChecksum& local = m_coSimChecksums[tick % CHECKSUM_HISTORY];
+	const SimulationChecksum& server = m_coSimServerChecksums[tick % CHECKSUM_HISTORY];
+	if (local.tick != tick || server.tick != tick)
+		return;
+
+	if (local.checksum != server.checksum)
+	{
+		std::cout << "Co-simulation diverged at tick " << tick << ", requesting resync." << std::endl;
+		RakNet::BitStream request;
+		request.Write((RakNet::MessageID)GameMessages::ID_SIMULATION_RESYNC);
+		m_network.getPeerInterface()->Send(&request, HIGH_PRIORITY, RELIABLE_ORDERED, 0, m_coSimServer, false);
+
+		// stop comparing until the correction arrives
+		m_coSimulating = false;
 	}
 }
 
-AIVector AssessmentNetworkingApplication::LowPass(AIVector prevFiltered, AIVector currRaw, float smoothingFactor)
+void AssessmentNetworkingApplication::StepSimulation()
 {
-	//Low pass filter to smooth out unrealistic movement 
-	//Late packets can cause this
-	AIVector resultingEntity;
-	resultingEntity.x = prevFiltered.x + smoothingFactor * (currRaw.x - prevFiltered.x);
-	resultingEntity.y = prevFiltered.y + smoothingFactor * (currRaw.y - prevFiltered.y);
+	++m_coSimTick;
+	for (auto& ai : m_coSimWander)
+	{
+		updateWander(ai, m_coSimArenaRadius, SIMULATION_TIMESTEP);
+		ai.data->ticks = m_coSimTick;
+	}
+
+	SimulationChecksum& entry = m_coSimChecksums[m_coSimTick % CHECKSUM_HISTORY];
+	entry.tick = m_coSimTick;
+	entry.checksum = wanderChecksum(m_coSimWander.data(), m_coSimWander.size());
+	CompareSimulationChecksum(m_coSimTick);
+}
+
+void AssessmentNetworkingApplication::publishFrame() {
+
+	FramePacket& packet = m_framePackets.writeBuffer();
+	packet.projectionView = m_camera->getProjectionView();
+	packet.frustum = m_camera->getFrustum();
+
+	// zoomed out over a big crowd just how dense it is gets drawn, so the grid is all that's copied
+	const EntityStateBuffer& entities = m_entityState.current();
+	packet.density = entities.size() > DENSITY_ENTITY_COUNT ||
+					 m_camera->getTransform()[3].y > densityCameraHeight;
+	if (packet.density)
+		m_densityRenderer.bin(entities, packet.grid);
+	else
+	{
+		// the next update's extrapolate moves entities by a smoothed fixed step, draw that far into it
+		packet.leadTime = getInterpolationAlpha() * getFixedTimestep() * (m_coSimulating ? 1 : smoothness);
+		packet.entities = entities;
+	}
+
+	packet.overlay = m_overlayVisible;
+	if (m_overlayVisible)
+	{
+		m_overlaySample.late = m_network.getLateSnapshots();
+		m_overlaySample.dropped = m_network.getDroppedSnapshots();
+		m_overlaySample.largestTick = m_largestTick;
+		m_overlaySample.allocations = AllocationCounter::take();
+		packet.overlaySample = m_overlaySample;
+		packet.width = getFramebufferWidth();
+		packet.height = getFramebufferHeight();
+		m_overlaySample = PerformanceOverlay::Sample();
+	}
+
+	// only the first frame to show a snapshot traces it
+	packet.trace = m_appliedTrace;
+	m_appliedTrace = LatencyTracer::Trace();
 
-	return resultingEntity;
+	m_framePackets.publish();
+
+	// goes towards the next frame's sample, this one's already been handed over
+	long long gizmosStart = startTimer(m_overlayVisible);
+	Gizmos::publish();
+	m_overlaySample.gizmos += millisecondsSince(gizmosStart);
+}
+
+void AssessmentNetworkingApplication::acquireFrame() {
+	m_frameAcquired = m_framePackets.acquire();
+	Gizmos::acquire();
 }
 
 void AssessmentNetworkingApplication::draw() {
 
+	// the newest packet, or the last one again if update hasn't published since
+	bool published = m_frameAcquired;
+	const FramePacket& packet = m_framePackets.readBuffer();
+	long long submitStart = startTimer(packet.overlay);
+
 	// clear the screen for this frame
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// draw entities
-	for (auto& ai : m_aiTrueData)
+	// draw entities, the arrows are built on the GPU
+	if (packet.density)
+		m_densityRenderer.draw(packet.grid, packet.projectionView);
+	else
+		m_entityRenderer.draw(packet.entities, packet.projectionView, vec4(1, 0, 0, 1), &packet.frustum, packet.leadTime);
+
+	// display the 3D gizmos
+	Gizmos::draw(packet.projectionView);
+
+	// over the top of everything else, a packet drawn again isn't a new frame on the graphs
+	if (packet.overlay)
 	{
-		vec3 p1 = vec3(ai.position.x + ai.velocity.x * 0.25f, 0, ai.position.y + ai.velocity.y * 0.25f);
-		vec3 p2 = vec3(ai.position.x, 0, ai.position.y) - glm::cross(vec3(ai.velocity.x, 0, ai.velocity.y), vec3(0, 1, 0)) * 0.1f;
-		vec3 p3 = vec3(ai.position.x, 0, ai.position.y) + glm::cross(vec3(ai.velocity.x, 0, ai.velocity.y), vec3(0, 1, 0)) * 0.1f;
-		Gizmos::addTri(p1, p2, p3, glm::vec4(1, 0, 0, 1));
+		if (published)
+			m_overlay.addFrame(packet.overlaySample, millisecondsSince(submitStart), Gizmos::getStats().primitives);
+		m_overlay.draw(packet.width, packet.height);
 	}
 
-	// display the 3D gizmos
-	Gizmos::draw(m_camera->getProjectionView());
+	if (published && packet.trace.applied != 0)
+		m_latency.drawn(packet.trace);
+}
+
+void AssessmentNetworkingApplication::swapped() {
+	m_latency.swapped();
+}
+
+void AssessmentNetworkingApplication::framebufferResized(int width, int height) {
+	// shapes are added on this thread, so the level of detail can change here, minimised is left alone
+	if (height > 0)
+		Gizmos::setLevelOfDetail((float)height);
 }
\ No newline at end of file
@@ -2,13 +2,22 @@
 
 #include "BaseApplication.h"
 #include "AIEntity.h"
+#include "EntityState.h"
+#include "EntityRenderer.h"
+#include "DensityRenderer.h"
+#include "PerformanceOverlay.h"
+#include "LatencyTracer.h"
+#include "ClientNetwork.h"
+#include "Frustum.h"
+#include "TripleBuffer.h"
+#include <glm/mat4x4.hpp>
 #include <vector>
 #include <queue>
 
 class Camera;
 
 namespace RakNet {
-	class RakPeerInterface;
+	struct Packet;
 }
 
 class AssessmentNetworkingApplication : public BaseApplication {
@@ -22,35 +31,119 @@ public:
 
 	virtual bool update(float deltaTime);
 
+	virtual void publishFrame();
+	virtual void acquireFrame();
 	virtual void draw();
+	virtual void swapped();
+	virtual void framebufferResized(int width, int height);
 
-	void EntitySanityCheck();
-	AIVector LowPass(AIVector prevFiltered, AIVector currRaw, float smoothingFactor);
+	// adds and removes entities, snapshots only ever move the ones we know about
+	void ReceiveEntityEvents(RakNet::Packet* packet);
+
+	// takes the newest snapshot from the network thread into the filtered state
+	void EntitySanityCheck(const ReceivedSnapshot& snapshot);
+
+	// co-simulation of the server's wander AI
+	void ReceiveSimulationState(RakNet::Packet* packet);
+	void ReceiveSimulationChecksum(RakNet::Packet* packet);
+	void StepSimulation();
+
+	// requests a resync if we and the server both have a checksum for tick and they differ
+	void CompareSimulationChecksum(unsigned int tick);
 
 private:
 
-	RakNet::RakPeerInterface*	m_peerInterface;
+	ClientNetwork				m_network;
 
 	Camera*						m_camera;
 
-	std::vector<AIEntity>		m_aiEntities;
-
-	std::vector<AIEntity>		m_aiLastFiltedFrame;
-	std::vector<AIEntity>		m_aiTrueData;
-	std::vector<AIEntity>		m_aiSkippedEntitys;
+	// filtered entities, what we draw
+	EntityState					m_entityState;
+	EntityRenderer				m_entityRenderer;
+	DensityRenderer				m_densityRenderer;
+
+	// F3 shows and hides it, nothing is timed or counted while it's hidden
+	PerformanceOverlay			m_overlay;
+	bool						m_overlayVisible;
+	bool						m_overlayKeyDown;
+	PerformanceOverlay::Sample	m_overlaySample;	// added to by this frame's updates
+
+	// the last snapshot applied, until a frame is published with it
+	LatencyTracer				m_latency;
+	LatencyTracer::Trace		m_appliedTrace;
+
+	// everything draw reads, copied from the update thread's state once a frame, so the render
+	// thread never sees it change part way through
+	struct FramePacket {
+		FramePacket() : projectionView(1), density(false), leadTime(0), overlay(false), width(0), height(0) { grid.most = 0; }
+
+		glm::mat4				projectionView;
+		Frustum					frustum;
+		bool					density;	// the grid is drawn rather than the entities
+		float					leadTime;
+		EntityStateBuffer		entities;
+		DensityRenderer::Grid	grid;
+
+		bool						overlay;	// the rest is only filled in when it's visible
+		PerformanceOverlay::Sample	overlaySample;
+		int							width;
+		int							height;
+
+		LatencyTracer::Trace		trace;		// applied is 0 unless this is the first frame with a new snapshot
+	};
+	TripleBuffer<FramePacket>	m_framePackets;
+	bool						m_frameAcquired;	// drawing thread only, the packet is new rather than drawn again
+
+	// past this many entities, or with the camera this high above the ground, the crowd is drawn as a density map
+	static const unsigned int DENSITY_ENTITY_COUNT = 200000;
+	static const float densityCameraHeight;
 
 	//The larger the smoothness the more data is taken from the delta of the new and old data
 	static const float smoothness;
 
+	//Entities further than this from their filtered position have teleported
+	static const float teleportDistance;
+
 	bool m_lastFrameSkipped;
 
 	int m_largestTick;
 	float m_packetTime;
-	int m_skippedFrames;
+
+	// held last update, keys act once per press
+	bool m_profileKeyDown;
+	bool m_traceKeyDown;
+	bool m_telemetryKeyDown;
 
 	float prevTime;
 	float deltaTime;
 
+	// co-simulation state, only used once the server has sent ID_SIMULATION_STATE
+	bool							m_coSimulating;
+	unsigned int					m_coSimTick;
+	unsigned int					m_coSimServerTick;
+	float							m_coSimAccumulator;
+	float							m_coSimArenaRadius;
+	std::vector<AIEntity>			m_coSimEntities;
+	std::vector<AIServerEntity>		m_coSimWander;
+	RakNet::SystemAddress			m_coSimServer;
+
+	// recent local and server checksums, each compared once the other side has reached its tick
+	struct SimulationChecksum {
+		unsigned int tick;
+		unsigned int checksum;
+	};
+	static const unsigned int CHECKSUM_HISTORY = 256;
+	SimulationChecksum				m_coSimChecksums[CHECKSUM_HISTORY];
+	SimulationChecksum				m_coSimServerChecksums[CHECKSUM_HISTORY];
+
+	// how far the local simulation may run ahead of the last server tick heard, several of the
+	// server's checksum intervals so a checksum held up on the way doesn't stop us
+	static const unsigned int MAX_SIMULATION_LEAD = 120;
+
+	// steps an update may take on top of its own to catch up with the server, so falling behind
+	// is made up over a few frames rather than in one
+	static const unsigned int MAX_CATCH_UP_STEPS = 4;
+
 
 
 };
\ No newline at end of file
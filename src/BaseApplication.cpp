@@ -1,14 +1,46 @@
 #include "BaseApplication.h"
 #include "gl_core_4_4.h"
+#include "Profiler.h"
+#include "RenderState.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <thread>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+const float BaseApplication::MAX_FRAME_TIME = 0.25f;
+const float BaseApplication::FRAME_REPORT_INTERVAL = 5.0f;
+
+BaseApplication::BaseApplication()
+	: m_window(nullptr),
+	m_fixedTimestep(1 / 60.0f),
+	m_interpolationAlpha(0),
+	m_vsync(false),
+	m_frameRateLimit(0),
+	m_lastReport(0),
+	m_windowSize(0),
+	m_framebufferWidth(0),
+	m_framebufferHeight(0),
+	m_renderThread(false),
+	m_framesPublished(0),
+	m_framesAcquired(0),
+	m_stopRendering(false) {
+	m_frameTimeStats = FrameTimeStats{ 0, 0, 0, 0, 0 };
+}
+
 bool BaseApplication::createWindow(const char* title, int width, int height) {
 
 	if (glfwInit() == GL_FALSE)
 		return false;
 
+	// 3.3 core is everything the renderers use, and what Mesa's software rasteriser
+	// (llvmpipe, e.g. LIBGL_ALWAYS_SOFTWARE=1) reliably provides
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+
 	m_window = glfwCreateWindow(width, height, title, nullptr, nullptr);
 	if (m_window == nullptr) {
 		glfwTerminate();
@@ -16,6 +48,7 @@ bool BaseApplication::createWindow(const char* title, int width, int height) {
 	}
 
 	glfwMakeContextCurrent(m_window);
+	glfwSwapInterval(m_vsync ? 1 : 0);
 
 	if (ogl_LoadFunctions() == ogl_LOAD_FAILED) {
 		glfwDestroyWindow(m_window);
@@ -23,7 +56,17 @@ bool BaseApplication::createWindow(const char* title, int width, int height) {
 		return false;
 	}
 
-	glfwSetWindowSizeCallback(m_window, [](GLFWwindow*, int w, int h){ glViewport(0, 0, w, h); });
+	// events are polled on the update thread, which may not have the context, so the size is
+	// only noted here and the drawing thread resizes the viewport, in pixels rather than screen units
+	glfwGetFramebufferSize(m_window, &m_framebufferWidth, &m_framebufferHeight);
+	glfwSetWindowUserPointer(m_window, this);
+	glfwSetFramebufferSizeCallback(m_window, [](GLFWwindow* window, int w, int h){
+		BaseApplication* app = (BaseApplication*)glfwGetWindowUserPointer(window);
+		app->m_windowSize = ((unsigned int)w << 16) | ((unsigned int)h & 0xffff);
+		app->m_framebufferWidth = w;
+		app->m_framebufferHeight = h;
+		app->framebufferResized(w, h);
+	});
 
 	auto major = ogl_GetMajorVersion();
 	auto minor = ogl_GetMinorVersion();
@@ -31,8 +74,10 @@ bool BaseApplication::createWindow(const char* title, int width, int height) {
 
 	glClearColor(0.25f, 0.25f, 0.25f, 1);
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	// from here on GL state only changes through RenderState
+	RenderState::reset();
+	RenderState::setEnabled(RenderState::DEPTH_TEST, true);
+	RenderState::setEnabled(RenderState::CULL_FACE, true);
 	
 	return true;
 }
@@ -43,18 +88,185 @@ void BaseApplication::destroyWindow() {
 	glfwTerminate();
 }
 
+void BaseApplication::setVSync(bool enabled) {
+	m_vsync = enabled;
+	if (m_window != nullptr && glfwGetCurrentContext() == m_window)
+		glfwSwapInterval(m_vsync ? 1 : 0);
+}
+
+void BaseApplication::applyWindowSize() {
+	unsigned int size = m_windowSize.exchange(0);
+	if (size != 0)
+		glViewport(0, 0, size >> 16, size & 0xffff);
+}
+
 void BaseApplication::run() {
 
 	double prevTime = glfwGetTime();
-	double currTime = 0;
+	double accumulator = 0;
+	m_lastReport = prevTime;
+	Profiler::setThreadName("main");
+
+	// the context can only be current on one thread at a time
+	std::thread renderer;
+	if (m_renderThread) {
+		m_framesPublished = m_framesAcquired = 0;
+		m_stopRendering = false;
+		glfwMakeContextCurrent(nullptr);
+		renderer = std::thread(&BaseApplication::renderLoop, this);
+	}
 
-	while (currTime = glfwGetTime(),
-		update((float)(currTime - prevTime))) {
+	for (;;) {
+		double frameStart = glfwGetTime();
+		double frameTime = std::min(frameStart - prevTime, (double)MAX_FRAME_TIME);
+		prevTime = frameStart;
 
-		glfwPollEvents();
-		draw();
-		glfwSwapBuffers(m_window);
+		{
+			PROFILE_SCOPE("poll events");
+			glfwPollEvents();
+		}
 
-		prevTime = currTime;
+		// the simulation and networking always step by the same amount, however fast we draw
+		accumulator += frameTime;
+		bool running = true;
+		while (running && accumulator >= m_fixedTimestep) {
+			PROFILE_SCOPE("update");
+			running = update(m_fixedTimestep);
+			accumulator -= m_fixedTimestep;
+		}
+		if (running == false)
+			break;
+
+		m_interpolationAlpha = (float)(accumulator / m_fixedTimestep);
+
+		if (m_renderThread == false) {
+			{
+				PROFILE_SCOPE("publish");
+				publishFrame();
+			}
+			{
+				PROFILE_SCOPE("draw");
+				acquireFrame();
+				applyWindowSize();
+				draw();
+			}
+			{
+				PROFILE_SCOPE("swap");
+				glfwSwapBuffers(m_window);
+				RenderState::endFrame();
+				swapped();
+			}
+
+			limitFrameRate(frameStart);
+			recordFrameTime((float)(glfwGetTime() - frameStart));
+			continue;
+		}
+
+		// held until the render thread has taken the last frame, so none are skipped and
+		// updates never get more than a frame ahead of what's on screen
+		{
+			PROFILE_SCOPE("wait for render");
+			std::unique_lock<std::mutex> lock(m_frameMutex);
+			m_frameSignal.wait(lock, [this]() { return m_framesAcquired == m_framesPublished; });
+		}
+		{
+			PROFILE_SCOPE("publish");
+			publishFrame();
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_frameMutex);
+			++m_framesPublished;
+		}
+		m_frameSignal.notify_all();
+
+		limitFrameRate(frameStart);
 	}
-}
\ No newline at end of file
+
+	if (renderer.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(m_frameMutex);
+			m_stopRendering = true;
+		}
+		m_frameSignal.notify_all();
+		renderer.join();
+
+		// shutdown cleans up on this thread
+		glfwMakeContextCurrent(m_window);
+	}
+}
+
+void BaseApplication::renderLoop() {
+	glfwMakeContextCurrent(m_window);
+	glfwSwapInterval(m_vsync ? 1 : 0);
+	Profiler::setThreadName("render");
+
+	double prevTime = glfwGetTime();
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(m_frameMutex);
+			m_frameSignal.wait(lock, [this]() { return m_stopRendering || m_framesAcquired != m_framesPublished; });
+			if (m_stopRendering)
+				break;
+
+			// taken before the update thread is let go, so it's this frame draw gets and not the next
+			acquireFrame();
+			m_framesAcquired = m_framesPublished;
+		}
+		m_frameSignal.notify_all();
+
+		{
+			PROFILE_SCOPE("draw");
+			applyWindowSize();
+			draw();
+		}
+		{
+			PROFILE_SCOPE("swap");
+			glfwSwapBuffers(m_window);
+			RenderState::endFrame();
+			swapped();
+		}
+
+		// swap to swap, which is what's on screen
+		double now = glfwGetTime();
+		recordFrameTime((float)(now - prevTime));
+		prevTime = now;
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
+
+void BaseApplication::limitFrameRate(double frameStart) const {
+	if (m_frameRateLimit <= 0)
+		return;
+	PROFILE_SCOPE("limit frame rate");
+
+	double frameEnd = frameStart + 1.0 / m_frameRateLimit;
+
+	// sleeps can overshoot by a scheduler tick, so the last couple of milliseconds are yielded away
+	double remaining = frameEnd - glfwGetTime();
+	if (remaining > 0.002)
+		std::this_thread::sleep_for(std::chrono::microseconds((long long)((remaining - 0.002) * 1000000)));
+	while (glfwGetTime() < frameEnd)
+		std::this_thread::yield();
+}
+
+void BaseApplication::recordFrameTime(float seconds) {
+	m_frameTimes.push_back(seconds);
+
+	double now = glfwGetTime();
+	if (now - m_lastReport < FRAME_REPORT_INTERVAL)
+		return;
+	m_lastReport = now;
+
+	m_sortedFrameTimes = m_frameTimes;
+	m_frameTimes.clear();
+	std::sort(m_sortedFrameTimes.begin(), m_sortedFrameTimes.end());
+
+	size_t last = m_sortedFrameTimes.size() - 1;
+	auto percentile = [&](float p) { return m_sortedFrameTimes[(size_t)(last * p + 0.5f)] * 1000; };
+	m_frameTimeStats = FrameTimeStats{ percentile(0.5f), percentile(0.95f), percentile(0.99f),
+									   m_sortedFrameTimes[last] * 1000, (unsigned int)m_sortedFrameTimes.size() };
+
+	std::cout << "Frame time (ms) over " << m_frameTimeStats.frames << " frames: 50% " << m_frameTimeStats.p50 <<
+		", 95% " << m_frameTimeStats.p95 << ", 99% " << m_frameTimeStats.p99 << ", max " << m_frameTimeStats.max << std::endl;
+}
@@ -1,13 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
 struct GLFWwindow;
 
 class BaseApplication {
 public:
 
-	BaseApplication() {}
+	BaseApplication();
 	virtual ~BaseApplication() {}
 
+	// update is called with the fixed timestep as many times as the time since the last frame
+	// holds, then draw once with however far into the next step it is as the interpolation alpha
+	// with a render thread, draw runs on it alongside the next frame's updates
 	void run();
 	
 	virtual bool startup() = 0;
@@ -16,10 +24,98 @@ public:
 	virtual bool update(float deltaTime) = 0;
 	virtual void draw() = 0;
 
+	// called on the update thread after each frame's updates, to hand draw everything it reads,
+	// with a render thread draw mustn't touch anything update changes except through this
+	virtual void publishFrame() {}
+
+	// called on the drawing thread before each draw, while the update thread is held, to take
+	// what publishFrame handed over so a frame can't be published over before draw gets it
+	virtual void acquireFrame() {}
+
+	// called on the drawing thread straight after each swap, with draw's GL context still current
+	virtual void swapped() {}
+
+	// milliseconds, over the frames since the last report
+	struct FrameTimeStats {
+		float			p50;
+		float			p95;
+		float			p99;
+		float			max;
+		unsigned int	frames;
+	};
+
+	// printed every FRAME_REPORT_INTERVAL seconds, this is the last one printed, from the drawing thread
+	const FrameTimeStats&	getFrameTimeStats() const	{ return m_frameTimeStats; }
+
 protected:
 
 	virtual bool createWindow(const char* title, int width, int height);
 	virtual void destroyWindow();
 
+	// called on the update thread while events are polled, when the window's framebuffer changes
+	// size, the drawing thread resizes the viewport to match before its next draw
+	virtual void framebufferResized(int width, int height) {}
+
+	// the framebuffer's size in pixels, which can differ from the window's, for the update thread
+	int		getFramebufferWidth() const			{ return m_framebufferWidth; }
+	int		getFramebufferHeight() const		{ return m_framebufferHeight; }
+
+	void	setFixedTimestep(float seconds)		{ m_fixedTimestep = seconds; }
+	float	getFixedTimestep() const			{ return m_fixedTimestep; }
+
+	// how far the current draw is between the last update and the next, in [0, 1)
+	// with a render thread it's for publishFrame to pass on, it changes while draw runs
+	float	getInterpolationAlpha() const		{ return m_interpolationAlpha; }
+
+	// waits for the vertical blank on swap, can be set before or after createWindow
+	void	setVSync(bool enabled);
+
+	// sleeps out the rest of each frame so there are at most this many a second, 0 is uncapped
+	// and on top of vsync it only matters when the driver doesn't honour the swap interval
+	void	setFrameRateLimit(float framesPerSecond)	{ m_frameRateLimit = framesPerSecond; }
+
+	// draws on a thread of its own, which takes the GL context for the length of run, so GL
+	// can only be used in startup, draw and shutdown, call before run
+	void	setRenderThread(bool enabled)				{ m_renderThread = enabled; }
+
 	GLFWwindow*	m_window;
-};
\ No newline at end of file
+
+private:
+
+	// waits until a frame started at frameStart has taken 1 / m_frameRateLimit
+	void	limitFrameRate(double frameStart) const;
+
+	void	recordFrameTime(float seconds);
+
+	// the render thread, draws each frame published until run stops it
+	void	renderLoop();
+
+	// resizes the viewport if the window has been, on the drawing thread
+	void	applyWindowSize();
+
+	// frames longer than this are clamped, so a hitch doesn't turn into a burst of updates
+	static const float		MAX_FRAME_TIME;
+	static const float		FRAME_REPORT_INTERVAL;
+
+	float				m_fixedTimestep;
+	float				m_interpolationAlpha;
+	bool				m_vsync;
+	float				m_frameRateLimit;
+
+	std::vector<float>	m_frameTimes;		// seconds, since the last report
+	std::vector<float>	m_sortedFrameTimes;
+	double				m_lastReport;
+	FrameTimeStats		m_frameTimeStats;
+
+	// width in the high 16 bits and height in the low, set by the size callback and 0 once applied
+	std::atomic<unsigned int>	m_windowSize;
+	int							m_framebufferWidth;
+	int							m_framebufferHeight;
+
+	bool					m_renderThread;
+	std::mutex				m_frameMutex;
+	std::condition_variable	m_frameSignal;
+	unsigned int			m_framesPublished;
+	unsigned int			m_framesAcquired;	// by the render thread, never more than one behind
+	bool					m_stopRendering;
+};
@@ -8,7 +8,8 @@ Camera::Camera(float fovY, float aspectRatio, float near, float far)
 	: m_speed(10),
 	m_up(0,1,0),
 	m_transform(1),
-	m_view(1)
+	m_view(1),
+	m_window(glfwGetCurrentContext())
 {
 	setPerspective(fovY, aspectRatio, near, far);
 }
@@ -22,6 +23,7 @@ void Camera::setPerspective(float fovY, float aspectRatio, float near, float far
 {
 	m_projection = glm::perspective(fovY, aspectRatio, near, far);
 	m_projectionView = m_projection * m_view;
+	m_frustum.extract(m_projectionView);
 }
 
 void Camera::setLookAtFrom(const glm::vec3& from, const glm::vec3& to)
@@ -29,11 +31,12 @@ void Camera::setLookAtFrom(const glm::vec3& from, const glm::vec3& to)
 	m_view = glm::lookAt(from, to, glm::vec3(0, 1, 0));
 	m_transform = glm::inverse(m_view);
 	m_projectionView = m_projection * m_view;
+	m_frustum.extract(m_projectionView);
 }
 
 void Camera::update(float deltaTime)
 {
-	GLFWwindow* window = glfwGetCurrentContext();
+	GLFWwindow* window = m_window;
 
 	float frameSpeed = glfwGetKey(window,GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS ? deltaTime * m_speed * 2 : deltaTime * m_speed;	
 
@@ -100,12 +103,13 @@ void Camera::update(float deltaTime)
 
 	m_view = glm::inverse(m_transform);
 	m_projectionView = m_projection * m_view;
+	m_frustum.extract(m_projectionView);
 }
 
 glm::vec3 Camera::screenPositionToDirection(float x, float y) const {
 	
 	int width = 0, height = 0;
-	glfwGetWindowSize(glfwGetCurrentContext(), &width, &height);
+	glfwGetWindowSize(m_window, &width, &height);
 
 	glm::vec3 screenPos(x / width * 2 - 1, (y / height * 2 - 1) * -1, -1);
 
@@ -118,7 +122,7 @@ glm::vec3 Camera::screenPositionToDirection(float x, float y) const {
 glm::vec3 Camera::pickAgainstPlane(float x, float y, const glm::vec4& plane) const {
 
 	int width = 0, height = 0;
-	glfwGetWindowSize(glfwGetCurrentContext(), &width, &height);
+	glfwGetWindowSize(m_window, &width, &height);
 
 	glm::vec3 screenPos(x / width * 2 - 1, (y / height * 2 - 1) * -1, -1);
 
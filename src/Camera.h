@@ -2,10 +2,15 @@
 
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
+#include "Frustum.h"
+
+struct GLFWwindow;
 
 class Camera {
 public:
 
+	// reads input from the window whose context is current when it's constructed, so it can
+	// update on a thread other than the one drawing
 	Camera(float fovY, float aspectRatio, float near, float far);
 	virtual ~Camera();
 
@@ -22,6 +27,9 @@ public:
 	const glm::mat4&	getView() const				{ return m_view; }
 	const glm::mat4&	getProjectionView() const	{ return m_projectionView; }
 
+	// kept in step with the projection view
+	const Frustum&		getFrustum() const			{ return m_frustum; }
+
 	// returns a world-space normalized vector pointing away from the camera's world-space position
 	glm::vec3			screenPositionToDirection(float x, float y) const;
 
@@ -37,4 +45,7 @@ private:
 	glm::mat4	m_projection;
 	glm::mat4	m_view;
 	glm::mat4	m_projectionView;
+	Frustum		m_frustum;
+
+	GLFWwindow*	m_window;
 };
\ No newline at end of file
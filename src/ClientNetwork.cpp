@@ -0,0 +1,248 @@
+#include "ClientNetwork.h"
+#include "Profiler.h"
+#include <iostream>
+
+#include <RakPeerInterface.h>
+#include <MessageIdentifiers.h>
+#include <BitStream.h>
+#include <RakSleep.h>
+#include <RakNetStatistics.h>
+#include <GetTime.h>
+
+ClientNetwork::ClientNetwork()
+	: m_peerInterface(nullptr),
+	m_running(false),
+	m_droppedSnapshots(0),
+	m_lateSnapshots(0),
+	m_publishedTick(0),
+	m_serverAddress(RakNet::UNASSIGNED_SYSTEM_ADDRESS),
+	m_lastLinkSample(0) {
+}
+
+ClientNetwork::~ClientNetwork() {
+	shutdown();
+}
+
+bool ClientNetwork::startup(const char* address, unsigned short port) {
+	m_peerInterface = RakNet::RakPeerInterface::GetInstance();
+
+	RakNet::SocketDescriptor sd;
+	m_peerInterface->Startup(1, &sd, 1);
+
+	// keeps the clock differential to the server current, snapshot times are converted with it
+	m_peerInterface->SetOccasionalPing(true);
+
+	// request access to server
+	RakNet::ConnectionAttemptResult res = m_peerInterface->Connect(address, port, nullptr, 0);
+
+	if (res != RakNet::CONNECTION_ATTEMPT_STARTED) {
+		std::cout << "Unable to start connection, Error number: " << res << std::endl;
+		return false;
+	}
+
+	m_running = true;
+	m_thread = std::thread(&ClientNetwork::run, this);
+	return true;
+}
+
+void ClientNetwork::shutdown() {
+	m_running = false;
+	if (m_thread.joinable())
+		m_thread.join();
+
+	if (m_peerInterface != nullptr) {
+		// hand back anything the main thread never took
+		while (RakNet::Packet* packet = receivePacket())
+			releasePacket(packet);
+		for (unsigned int i = 0; i < TripleBuffer<ReceivedSnapshot>::COUNT; ++i)
+			releaseSnapshot(m_snapshots.buffer(i));
+
+		m_peerInterface->Shutdown(0);
+		RakNet::RakPeerInterface::DestroyInstance(m_peerInterface);
+		m_peerInterface = nullptr;
+	}
+}
+
+const ReceivedSnapshot* ClientNetwork::acquireSnapshot() {
+	if (m_snapshots.acquire() == false)
+		return nullptr;
+	return &m_snapshots.readBuffer();
+}
+
+RakNet::Packet* ClientNetwork::receivePacket() {
+	RakNet::Packet** entry = m_packets.ReadLock();
+	if (entry == nullptr)
+		return nullptr;
+	RakNet::Packet* packet = *entry;
+	m_packets.ReadUnlock();
+	return packet;
+}
+
+void ClientNetwork::releasePacket(RakNet::Packet* packet) {
+	m_peerInterface->DeallocatePacket(packet);
+}
+
+void ClientNetwork::run() {
+	Profiler::setThreadName("network");
+
+	while (m_running) {
+
+		// RakNet's view of the link, once a second
+		RakNet::TimeMS now = RakNet::GetTimeMS();
+		if (m_serverAddress != RakNet::UNASSIGNED_SYSTEM_ADDRESS && now - m_lastLinkSample >= 1000) {
+			m_lastLinkSample = now;
+			RakNet::RakNetStatistics statistics;
+			if (m_peerInterface->GetStatistics(m_serverAddress, &statistics) != nullptr)
+				m_telemetry.link((unsigned int)statistics.valueOverLastSecond[RakNet::ACTUAL_BYTES_RECEIVED], statistics.packetlossLastSecond,
+								 m_peerInterface->GetLastPing(m_serverAddress), m_peerInterface->GetAveragePing(m_serverAddress));
+		}
+
+		RakNet::Packet* packet = m_peerInterface->Receive();
+		if (packet == nullptr) {
+			RakSleep(1);
+			continue;
+		}
+
+		PROFILE_SCOPE("receive");
+		bool passedOn = false;
+
+		switch (packet->data[0]) {
+		case ID_CONNECTION_REQUEST_ACCEPTED: {
+			std::cout << "Our connection request has been accepted." << std::endl;
+			m_serverAddress = packet->systemAddress;
+			m_publishedTick = 0;
+			// let the server pick the snapshot format for this connection
+			RakNet::BitStream capabilities;
+			capabilities.Write((RakNet::MessageID)GameMessages::ID_CLIENT_CAPABILITIES);
+			capabilities.Write((unsigned int)(CAPABILITY_RESIDUALS | CAPABILITY_RANGE_CODING));
+			m_peerInterface->Send(&capabilities, HIGH_PRIORITY, RELIABLE_ORDERED, 0, packet->systemAddress, false);
+			break;
+		}
+		case ID_CONNECTION_ATTEMPT_FAILED:
+			std::cout << "Our connection request failed!" << std::endl;
+			break;
+		case ID_NO_FREE_INCOMING_CONNECTIONS:
+			std::cout << "The server is full." << std::endl;
+			break;
+		case ID_DISCONNECTION_NOTIFICATION:
+			std::cout << "We have been disconnected." << std::endl;
+			m_serverAddress = RakNet::UNASSIGNED_SYSTEM_ADDRESS;
+			break;
+		case ID_CONNECTION_LOST:
+			std::cout << "Connection lost." << std::endl;
+			m_serverAddress = RakNet::UNASSIGNED_SYSTEM_ADDRESS;
+			break;
+		case ID_ENTITY_LIST:
+			passedOn = receiveEntityList(packet);
+			break;
+		case ID_ENTITY_RESIDUALS:
+		case ID_ENTITY_RESIDUALS_RANGE:
+			receiveResiduals(packet);
+			break;
+		case ID_ENTITY_EVENTS:
+		case ID_SIMULATION_STATE:
+		case ID_SIMULATION_CHECKSUM: {
+			// the entity state and co-simulation live on the main thread
+			RakNet::Packet** entry = m_packets.WriteLock();
+			*entry = packet;
+			m_packets.WriteUnlock();
+			passedOn = true;
+			break;
+		}
+		default:
+			std::cout << "Received unhandled message." << std::endl;
+			break;
+		}
+
+		if (passedOn == false)
+			m_peerInterface->DeallocatePacket(packet);
+	}
+}
+
+bool ClientNetwork::receiveEntityList(RakNet::Packet* packet) {
+	ReceivedSnapshot& snapshot = beginSnapshot();
+	RakNet::Time serverTime = 0;
+	if (snapshot.entities.parse(packet->data, packet->length, snapshot.decoded, serverTime) == false ||
+		snapshot.entities.empty())
+		return false;
+
+	// the main thread filters straight out of the packet, it's deallocated once the buffer comes back round
+	bool inPlace = snapshot.entities.data() != snapshot.decoded.data();
+	if (inPlace)
+		snapshot.packet = packet;
+
+	snapshot.tick = snapshot.entities[0].ticks;
+	m_telemetry.arrived(snapshot.tick);
+	publishSnapshot(snapshot, serverTime);
+	return inPlace;
+}
+
+void ClientNetwork::receiveResiduals(RakNet::Packet* packet) {
+	RakNet::BitStream stream(packet->data, packet->length, false);
+	stream.IgnoreBytes(sizeof(RakNet::MessageID));
+
+	RakNet::BitStream ack;
+	ack.Write((RakNet::MessageID)GameMessages::ID_SNAPSHOT_ACK);
+
+	bool decoded = packet->data[0] == ID_ENTITY_RESIDUALS_RANGE ?
+		SnapshotCodec::readRangeResiduals(stream, m_snapshotHistory, m_decodedSnapshot) :
+		SnapshotCodec::readResiduals(stream, m_snapshotHistory, m_decodedSnapshot);
+
+	if (decoded == false) {
+		// we no longer have the baseline, ask for a snapshot that doesn't need one
+		ack.Write(SNAPSHOT_NO_BASELINE);
+		m_peerInterface->Send(&ack, HIGH_PRIORITY, UNRELIABLE, 0, packet->systemAddress, false);
+		return;
+	}
+
+	// keep it so the server can code against it once it sees our ack
+	QuantizedSnapshot& stored = m_snapshotHistory.store(m_decodedSnapshot.tick);
+	stored.time = m_decodedSnapshot.time;
+	stored.entities.swap(m_decodedSnapshot.entities);
+
+	ack.Write(stored.tick);
+	m_peerInterface->Send(&ack, HIGH_PRIORITY, UNRELIABLE, 0, packet->systemAddress, false);
+
+	ReceivedSnapshot& snapshot = beginSnapshot();
+	SnapshotCodec::dequantize(stored, snapshot.decoded);
+	if (snapshot.decoded.empty())
+		return;
+
+	snapshot.entities.assign(snapshot.decoded.data(), snapshot.decoded.size());
+	snapshot.tick = stored.tick;
+	m_telemetry.arrived(snapshot.tick);
+	publishSnapshot(snapshot, stored.time);
+}
+
+ReceivedSnapshot& ClientNetwork::beginSnapshot() {
+	// the main thread is done with whatever this buffer held before
+	ReceivedSnapshot& snapshot = m_snapshots.writeBuffer();
+	releaseSnapshot(snapshot);
+	return snapshot;
+}
+
+void ClientNetwork::publishSnapshot(ReceivedSnapshot& snapshot, RakNet::Time serverTime) {
+	// reordered on the way, so the main thread only ever sees ticks that increase
+	if (snapshot.tick <= m_publishedTick) {
+		++m_lateSnapshots;
+		m_telemetry.late();
+		return;
+	}
+	m_publishedTick = snapshot.tick;
+
+	// the server's time less the differential is the same moment on our clock, GetTime is GetTimeUS in milliseconds
+	RakNet::Time localTime = serverTime - m_peerInterface->GetClockDifferential(m_serverAddress);
+	snapshot.trace.sent = (long long)localTime * 1000;
+	snapshot.trace.received = LatencyTracer::now();
+
+	if (m_snapshots.publish())
+		++m_droppedSnapshots;
+}
+
+void ClientNetwork::releaseSnapshot(ReceivedSnapshot& snapshot) {
+	snapshot.entities.clear();
+	if (snapshot.packet != nullptr) {
+		m_peerInterface->DeallocatePacket(snapshot.packet);
+		snapshot.packet = nullptr;
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "AIEntity.h"
+#include "EntityList.h"
+#include "LatencyTracer.h"
+#include "NetworkTelemetry.h"
+#include "SnapshotCodec.h"
+#include "TripleBuffer.h"
+#include <RakNetTypes.h>
+#include <SingleProducerConsumer.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace RakNet {
+	class RakPeerInterface;
+	struct Packet;
+}
+
+// entities from a single ID_ENTITY_LIST / ID_ENTITY_RESIDUALS(_RANGE) message
+struct ReceivedSnapshot {
+	ReceivedSnapshot() : tick(0), packet(nullptr) {}
+
+	unsigned int			tick;
+	EntityListView			entities;
+
+	// sent and received, applied is left for the main thread to fill in
+	LatencyTracer::Trace	trace;
+
+	// an ID_ENTITY_LIST is read in place, so its packet is kept until the buffer is reused
+	RakNet::Packet*			packet;
+
+	// residuals, or an entity list that wasn't aligned in its packet, are decoded into here
+	std::vector<AIEntity>	decoded;
+};
+
+// receives and decodes packets on a background thread so that a render hitch doesn't
+// delay packet processing and a burst of packets doesn't stall the frame
+class ClientNetwork {
+public:
+
+	ClientNetwork();
+	~ClientNetwork();
+
+	bool	startup(const char* address, unsigned short port);
+	void	shutdown();
+
+	// the snapshot with the highest tick decoded since the last call, or nullptr if there isn't a newer one
+	// valid until the next call, anything superseded in between is dropped
+	const ReceivedSnapshot*	acquireSnapshot();
+
+	// messages the network thread doesn't handle itself, e.g. entity events and co-simulation state
+	// returns nullptr when there are none, each one must be passed back to releasePacket
+	RakNet::Packet*			receivePacket();
+	void					releasePacket(RakNet::Packet* packet);
+
+	// RakNet's Send is thread safe, so the main thread may still send through this
+	RakNet::RakPeerInterface*	getPeerInterface() const	{ return m_peerInterface; }
+
+	// snapshots decoded but superseded before the main thread took them
+	unsigned int			getDroppedSnapshots() const		{ return m_droppedSnapshots.load(); }
+
+	// snapshots decoded but discarded, reordered on the way so no newer than one already handed over
+	unsigned int			getLateSnapshots() const		{ return m_lateSnapshots.load(); }
+
+	// arrivals and the link are reported by the network thread, the rest is up to the main thread
+	NetworkTelemetry&		getTelemetry()					{ return m_telemetry; }
+
+private:
+
+	void	run();
+
+	bool	receiveEntityList(RakNet::Packet* packet);
+	void	receiveResiduals(RakNet::Packet* packet);
+	ReceivedSnapshot&	beginSnapshot();
+
+	// hands snapshot to the main thread unless it's no newer than one already handed over, which it
+	// would replace if that hadn't been taken yet, the buffer is simply reused for the next one
+	void	publishSnapshot(ReceivedSnapshot& snapshot, RakNet::Time serverTime);
+	void	releaseSnapshot(ReceivedSnapshot& snapshot);
+
+	RakNet::RakPeerInterface*	m_peerInterface;
+
+	std::thread					m_thread;
+	std::atomic<bool>			m_running;
+
+	// decoded snapshots, newest wins
+	TripleBuffer<ReceivedSnapshot>	m_snapshots;
+	std::atomic<unsigned int>		m_droppedSnapshots;
+	std::atomic<unsigned int>		m_lateSnapshots;
+	unsigned int					m_publishedTick;	// the highest, network thread only
+
+	// packets passed through to the main thread
+	DataStructures::SingleProducerConsumer<RakNet::Packet*>	m_packets;
+
+	// only touched by the network thread, baselines for ID_ENTITY_RESIDUALS
+	SnapshotHistory				m_snapshotHistory;
+	QuantizedSnapshot			m_decodedSnapshot;
+
+	NetworkTelemetry			m_telemetry;
+	RakNet::SystemAddress		m_serverAddress;	// UNASSIGNED_SYSTEM_ADDRESS until connected, network thread only
+	RakNet::TimeMS				m_lastLinkSample;
+};
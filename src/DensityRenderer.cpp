@@ -0,0 +1,323 @@
+#include "DensityRenderer.h"
+#include "gl_core_4_4.h"
+#include "RenderState.h"
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <emmintrin.h>
+
+// below this many entities per thread it's quicker to bin them all on this one
+static const size_t MIN_ENTITIES_PER_THREAD = 65536;
+static const unsigned int MAX_THREADS = 8;
+
+// the quad's corners come from gl_VertexID, drawn as a strip
+static const char* vsSource = "#version 330\n \
+					 uniform mat4 ProjectionView; \
+					 uniform vec2 Origin; \
+					 uniform float Size; \
+					 out vec2 vTexCoord; \
+					 void main() { \
+						vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1); \
+						vec2 position = Origin + corner * Size; \
+						vTexCoord = corner; \
+						gl_Position = ProjectionView * vec4(position.x, 0, position.y, 1); }";
+
+// log scaled so a few packed cells don't wash out the rest, blue through yellow to red
+static const char* fsSource = "#version 330\n \
+					 uniform sampler2D Density; \
+					 uniform float Max; \
+					 in vec2 vTexCoord; \
+					 out vec4 FragColor; \
+					 void main() { \
+						float count = texture(Density, vTexCoord).r; \
+						if (count <= 0) discard; \
+						float t = log(1 + count) / log(1 + Max); \
+						vec3 colour = t < 0.5 ? mix(vec3(0, 0, 1), vec3(1, 1, 0), t * 2) : mix(vec3(1, 1, 0), vec3(1, 0, 0), t * 2 - 1); \
+						FragColor = vec4(colour, 0.35 + 0.65 * t); }";
+
+DensityRenderer::DensityRenderer()
+	: m_shader(0),
+	m_projectionViewUniform(-1),
+	m_originUniform(-1),
+	m_sizeUniform(-1),
+	m_maxUniform(-1),
+	m_vao(0),
+	m_texture(0),
+	m_resolution(0),
+	m_workGeneration(0),
+	m_workThreads(0),
+	m_workBusy(0),
+	m_stopWorkers(false),
+	m_workEntities(nullptr),
+	m_workGrid(nullptr),
+	m_workSlice(0) {
+}
+
+DensityRenderer::~DensityRenderer() {
+	stopWorkers();
+}
+
+bool DensityRenderer::create(unsigned int resolution /* = 256 */) {
+	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
+	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
+
+	glShaderSource(vs, 1, (const char**)&vsSource, 0);
+	glCompileShader(vs);
+
+	glShaderSource(fs, 1, (const char**)&fsSource, 0);
+	glCompileShader(fs);
+
+	m_shader = glCreateProgram();
+	glAttachShader(m_shader, vs);
+	glAttachShader(m_shader, fs);
+	glLinkProgram(m_shader);
+
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+
+	int success = GL_FALSE;
+	glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE) {
+		int infoLogLength = 0;
+		glGetProgramiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
+		char* infoLog = new char[infoLogLength + 1];
+		infoLog[0] = 0;
+
+		glGetProgramInfoLog(m_shader, infoLogLength + 1, 0, infoLog);
+		printf("Error: Failed to link density shader program!\n%s\n", infoLog);
+		delete[] infoLog;
+
+		destroy();
+		return false;
+	}
+
+	m_projectionViewUniform = RenderState::uniformLocation(m_shader, "ProjectionView");
+	m_originUniform = RenderState::uniformLocation(m_shader, "Origin");
+	m_sizeUniform = RenderState::uniformLocation(m_shader, "Size");
+	m_maxUniform = RenderState::uniformLocation(m_shader, "Max");
+
+	// the sampler stays on unit 0
+	RenderState::useProgram(m_shader);
+	glUniform1i(RenderState::uniformLocation(m_shader, "Density"), 0);
+
+	glGenVertexArrays(1, &m_vao);
+
+	m_resolution = resolution;
+	m_counts.resize(m_resolution * m_resolution);
+
+	// float counts, allocated once and replaced with glTexSubImage2D every draw
+	glGenTextures(1, &m_texture);
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_resolution, m_resolution, 0, GL_RED, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// started once rather than every bin, they sleep on m_workSignal while nothing's binning
+	stopWorkers();
+	m_stopWorkers = false;
+	unsigned int threads = glm::min(glm::max(std::thread::hardware_concurrency(), 1u), MAX_THREADS);
+	for (unsigned int worker = 1; worker < threads; ++worker)
+		m_workers.emplace_back(&DensityRenderer::workerLoop, this, worker);
+	return true;
+}
+
+void DensityRenderer::destroy() {
+	if (m_texture != 0)
+		glDeleteTextures(1, &m_texture);
+	if (m_vao != 0)
+		RenderState::deleteVertexArray(m_vao);
+	if (m_shader != 0)
+		RenderState::deleteProgram(m_shader);
+	m_texture = m_vao = m_shader = 0;
+
+	stopWorkers();
+}
+
+void DensityRenderer::stopWorkers() {
+	{
+		std::lock_guard<std::mutex> lock(m_workMutex);
+		m_stopWorkers = true;
+	}
+	m_workSignal.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+}
+
+void DensityRenderer::workerLoop(unsigned int worker) {
+	unsigned int generation = 0;
+	for (;;) {
+		const EntityStateBuffer* entities;
+		const Grid* grid;
+		size_t slice;
+		{
+			std::unique_lock<std::mutex> lock(m_workMutex);
+			m_workSignal.wait(lock, [&]() { return m_stopWorkers || m_workGeneration != generation; });
+			if (m_stopWorkers)
+				return;
+			generation = m_workGeneration;
+
+			// smaller crowds are split over fewer threads
+			if (worker >= m_workThreads)
+				continue;
+			entities = m_workEntities;
+			grid = m_workGrid;
+			slice = m_workSlice;
+		}
+
+		size_t count = entities->size();
+		size_t begin = glm::min(slice * worker, count);
+		size_t end = glm::min(begin + slice, count);
+		binRange(*entities, *grid, begin, end, m_threadCounts.data() + m_counts.size() * (worker - 1));
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(m_workMutex);
+			last = --m_workBusy == 0;
+		}
+		if (last)
+			m_doneSignal.notify_one();
+	}
+}
+
+void DensityRenderer::binRange(const EntityStateBuffer& entities, const Grid& grid, size_t begin, size_t end, unsigned int* counts) const {
+	const float* px = entities.positionX.data();
+	const float* py = entities.positionY.data();
+	const float inverseCell = 1.0f / grid.cellSize;
+	const int last = (int)m_resolution - 1;
+
+	for (size_t i = begin; i < end; ++i) {
+		int x = (int)((px[i] - grid.originX) * inverseCell);
+		int y = (int)((py[i] - grid.originY) * inverseCell);
+		x = x < 0 ? 0 : (x > last ? last : x);
+		y = y < 0 ? 0 : (y > last ? last : y);
+		++counts[y * m_resolution + x];
+	}
+}
+
+void DensityRenderer::bin(const EntityStateBuffer& entities, Grid& grid) {
+	size_t count = entities.size();
+	const float* px = entities.positionX.data();
+	const float* py = entities.positionY.data();
+	grid.most = 0;
+	if (count == 0)
+		return;
+
+	// bounds of the crowd, four at a time
+	__m128 minimum = _mm_set1_ps(FLT_MAX);
+	__m128 maximum = _mm_set1_ps(-FLT_MAX);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(px + i);
+		__m128 y = _mm_loadu_ps(py + i);
+		minimum = _mm_min_ps(minimum, _mm_min_ps(x, y));
+		maximum = _mm_max_ps(maximum, _mm_max_ps(x, y));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, minimum);
+	float low = glm::min(glm::min(lanes[0], lanes[1]), glm::min(lanes[2], lanes[3]));
+	_mm_storeu_ps(lanes, maximum);
+	float high = glm::max(glm::max(lanes[0], lanes[1]), glm::max(lanes[2], lanes[3]));
+	for (; i < count; ++i) {
+		low = glm::min(low, glm::min(px[i], py[i]));
+		high = glm::max(high, glm::max(px[i], py[i]));
+	}
+
+	// a power of two cell size on a grid aligned to it, so the cells only move when the crowd
+	// doubles or halves in size rather than every time an entity on the edge moves
+	float cellSize = glm::max((high - low) / (m_resolution - 1), 1.0f / 64);
+	grid.cellSize = exp2f(ceilf(log2f(cellSize)));
+	grid.originX = floorf(low / grid.cellSize) * grid.cellSize;
+	grid.originY = grid.originX;
+
+	std::memset(m_counts.data(), 0, m_counts.size() * sizeof(unsigned int));
+
+	// every thread counts its slice into a grid of its own, then they're summed
+	unsigned int threads = (unsigned int)m_workers.size() + 1;
+	threads = (unsigned int)glm::min((size_t)threads, glm::max(count / MIN_ENTITIES_PER_THREAD, (size_t)1));
+
+	if (threads == 1) {
+		binRange(entities, grid, 0, count, m_counts.data());
+	}
+	else {
+		size_t cells = m_counts.size();
+		m_threadCounts.resize(cells * (threads - 1));
+		std::memset(m_threadCounts.data(), 0, m_threadCounts.size() * sizeof(unsigned int));
+
+		size_t slice = (count + threads - 1) / threads;
+		{
+			std::lock_guard<std::mutex> lock(m_workMutex);
+			m_workEntities = &entities;
+			m_workGrid = &grid;
+			m_workSlice = slice;
+			m_workThreads = threads;
+			m_workBusy = threads - 1;
+			++m_workGeneration;
+		}
+		m_workSignal.notify_all();
+
+		binRange(entities, grid, 0, glm::min(slice, count), m_counts.data());
+
+		{
+			std::unique_lock<std::mutex> lock(m_workMutex);
+			m_doneSignal.wait(lock, [this]() { return m_workBusy == 0; });
+		}
+
+		for (unsigned int t = 0; t < threads - 1; ++t) {
+			const unsigned int* counts = m_threadCounts.data() + cells * t;
+			for (size_t c = 0; c < cells; ++c)
+				m_counts[c] += counts[c];
+		}
+	}
+
+	grid.texels.resize(m_counts.size());
+	for (size_t c = 0; c < m_counts.size(); ++c) {
+		grid.texels[c] = (float)m_counts[c];
+		grid.most = glm::max(grid.most, m_counts[c]);
+	}
+}
+
+void DensityRenderer::draw(const EntityStateBuffer& entities, const glm::mat4& projectionView) {
+	if (m_shader == 0 || entities.size() == 0)
+		return;
+
+	bin(entities, m_grid);
+	draw(m_grid, projectionView);
+}
+
+void DensityRenderer::draw(const Grid& grid, const glm::mat4& projectionView) {
+	if (m_shader == 0 || grid.most == 0 || grid.texels.size() != m_resolution * m_resolution)
+		return;
+
+	glBindTexture(GL_TEXTURE_2D, m_texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_resolution, m_resolution, GL_RED, GL_FLOAT, grid.texels.data());
+
+	bool blendEnabled = RenderState::isEnabled(RenderState::BLEND);
+	bool depthMask = RenderState::getDepthMask();
+	unsigned int src, dst;
+	RenderState::getBlendFunc(src, dst);
+
+	RenderState::setEnabled(RenderState::BLEND, true);
+	RenderState::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	RenderState::setDepthMask(false);
+
+	RenderState::useProgram(m_shader);
+	glUniformMatrix4fv(m_projectionViewUniform, 1, false, glm::value_ptr(projectionView));
+	glUniform2f(m_originUniform, grid.originX, grid.originY);
+	glUniform1f(m_sizeUniform, grid.cellSize * m_resolution);
+	glUniform1f(m_maxUniform, (float)grid.most);
+
+	RenderState::bindVertexArray(m_vao);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	RenderState::setDepthMask(depthMask);
+	RenderState::setBlendFunc(src, dst);
+	RenderState::setEnabled(RenderState::BLEND, blendEnabled);
+}
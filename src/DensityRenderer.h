@@ -0,0 +1,76 @@
+#pragma once
+
+#include "EntityState.h"
+#include <glm/fwd.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// draws how crowded each part of the world is rather than the entities themselves, positions are
+// binned into a square grid on the CPU and the grid is drawn as one textured quad on the ground,
+// so past the binning the cost doesn't depend on how many entities there are
+class DensityRenderer {
+public:
+
+	DensityRenderer();
+	~DensityRenderer();
+
+	// needs a current GL context, the grid is resolution cells along each side
+	// also starts the threads that help bin big crowds, which wait until there's one to bin
+	bool	create(unsigned int resolution = 256);
+	void	destroy();
+
+	// the binned crowd, which is all draw needs, so it can be binned on one thread and drawn on another
+	struct Grid {
+		// the corner and cell size in world units, snapped so cells don't shimmer as the crowd moves
+		float				originX;
+		float				originY;
+		float				cellSize;
+		unsigned int		most;		// entities in the fullest cell
+		std::vector<float>	texels;		// resolution * resolution counts
+	};
+
+	// doesn't need the context, but only one thread may bin at a time
+	void	bin(const EntityStateBuffer& entities, Grid& grid);
+
+	void	draw(const Grid& grid, const glm::mat4& projectionView);
+	void	draw(const EntityStateBuffer& entities, const glm::mat4& projectionView);
+
+private:
+
+	// counts entities [begin, end) into counts, which is resolution * resolution cells
+	void	binRange(const EntityStateBuffer& entities, const Grid& grid, size_t begin, size_t end, unsigned int* counts) const;
+
+	// a helper thread, bins slice worker of each bin split over more than worker threads
+	void	workerLoop(unsigned int worker);
+	void	stopWorkers();
+
+	unsigned int	m_shader;
+	int				m_projectionViewUniform;
+	int				m_originUniform;
+	int				m_sizeUniform;
+	int				m_maxUniform;
+
+	unsigned int	m_vao;		// empty, the quad's corners come from gl_VertexID
+	unsigned int	m_texture;
+
+	unsigned int	m_resolution;
+
+	std::vector<unsigned int>	m_counts;
+	std::vector<unsigned int>	m_threadCounts;	// a grid per extra thread, summed into m_counts
+	Grid						m_grid;			// for drawing the entities directly
+
+	// the binning thread takes slice 0 of each bin and the workers the rest
+	std::vector<std::thread>	m_workers;
+	std::mutex					m_workMutex;
+	std::condition_variable		m_workSignal;		// a bin was handed out, or the workers should stop
+	std::condition_variable		m_doneSignal;		// the last worker with a slice finished it
+	unsigned int				m_workGeneration;
+	unsigned int				m_workThreads;		// taking part in the current bin, the binning thread included
+	unsigned int				m_workBusy;			// workers still binning their slice
+	bool						m_stopWorkers;
+	const EntityStateBuffer*	m_workEntities;
+	const Grid*					m_workGrid;
+	size_t						m_workSlice;
+};
@@ -0,0 +1,43 @@
+#include "EntityList.h"
+#include <BitStream.h>
+#include <cstring>
+
+void writeEntityList(RakNet::BitStream& stream, const AIEntity* entities, size_t count, RakNet::Time time) {
+	unsigned int size = (unsigned int)(count * sizeof(AIEntity));
+	stream.Write((RakNet::MessageID)GameMessages::ID_ENTITY_LIST);
+	stream.PadWithZeroToByteLength(ENTITY_LIST_HEADER_SIZE - sizeof(size) - sizeof(time));
+
+	// raw bytes, BitStream::Write would swap them to network order and parse reads them in place
+	stream.Write((const char*)&size, sizeof(size));
+	stream.Write((const char*)&time, sizeof(time));
+	stream.Write((const char*)entities, size);
+}
+
+bool EntityListView::parse(const unsigned char* data, size_t length, std::vector<AIEntity>& fallback, RakNet::Time& time) {
+	clear();
+
+	if (data == nullptr || length < ENTITY_LIST_HEADER_SIZE || data[0] != ID_ENTITY_LIST)
+		return false;
+
+	unsigned int size = 0;
+	std::memcpy(&size, data + ENTITY_LIST_HEADER_SIZE - sizeof(time) - sizeof(size), sizeof(size));
+	std::memcpy(&time, data + ENTITY_LIST_HEADER_SIZE - sizeof(time), sizeof(time));
+
+	// a truncated or corrupt message must not send the filter past the end of the packet
+	if (size % sizeof(AIEntity) != 0 || size > length - ENTITY_LIST_HEADER_SIZE)
+		return false;
+
+	size_t count = size / sizeof(AIEntity);
+	const unsigned char* entities = data + ENTITY_LIST_HEADER_SIZE;
+
+	// RakNet doesn't promise any alignment for packet data
+	if ((size_t)entities % alignof(AIEntity) != 0) {
+		fallback.resize(count);
+		std::memcpy(fallback.data(), entities, size);
+		assign(fallback.data(), count);
+		return true;
+	}
+
+	assign((const AIEntity*)entities, count);
+	return true;
+}
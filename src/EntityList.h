@@ -0,0 +1,45 @@
+#pragma once
+
+#include "AIEntity.h"
+#include <RakNetTime.h>
+#include <cstddef>
+#include <vector>
+
+namespace RakNet {
+	class BitStream;
+}
+
+// bytes in front of the AIEntity array of an ID_ENTITY_LIST, the message ID padded out to 4 bytes,
+// the array's size and the tick's time, so the array sits aligned in the packet and can be read in place
+static const unsigned int ENTITY_LIST_HEADER_SIZE = 16;
+
+// writes a complete ID_ENTITY_LIST message, time is the server's RakNet::GetTime when it stepped to the tick
+void writeEntityList(RakNet::BitStream& stream, const AIEntity* entities, size_t count, RakNet::Time time);
+
+// read-only view over an AIEntity array, either straight over the bytes of a received
+// ID_ENTITY_LIST or over entities decoded elsewhere, it never owns what it points at
+class EntityListView {
+public:
+
+	EntityListView() : m_entities(nullptr), m_count(0) {}
+
+	// checks the header and byte count of an ID_ENTITY_LIST message and points the view at
+	// its entities, returns false and leaves the view empty if the message is malformed
+	// the entities are only copied, into fallback, if they don't sit aligned in the packet
+	// time is set to when the server stepped to the tick, on its clock
+	bool	parse(const unsigned char* data, size_t length, std::vector<AIEntity>& fallback, RakNet::Time& time);
+
+	void	assign(const AIEntity* entities, size_t count)	{ m_entities = entities; m_count = count; }
+	void	clear()											{ assign(nullptr, 0); }
+
+	const AIEntity*	data() const	{ return m_entities; }
+	size_t			size() const	{ return m_count; }
+	bool			empty() const	{ return m_count == 0; }
+
+	const AIEntity&	operator[](size_t index) const	{ return m_entities[index]; }
+
+private:
+
+	const AIEntity*	m_entities;
+	size_t			m_count;
+};
@@ -0,0 +1,235 @@
+#include "EntityRenderer.h"
+#include "EntityState.h"
+#include "gl_core_4_4.h"
+#include "RenderState.h"
+#include "Frustum.h"
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <cstdio>
+#include <emmintrin.h>
+
+// attribute locations, also bound by name below
+enum {
+	ATTRIBUTE_POSITION_X,
+	ATTRIBUTE_POSITION_Y,
+	ATTRIBUTE_VELOCITY_X,
+	ATTRIBUTE_VELOCITY_Y,
+	ATTRIBUTE_COUNT,
+};
+
+// the same arrow the client used to build on the CPU, with the cross products against
+// +Y worked out: cross(velocity, up) is (-velocity.z, 0, velocity.x)
+static const char* vsSource = "#version 330\n \
+					 in float PositionX; \
+					 in float PositionY; \
+					 in float VelocityX; \
+					 in float VelocityY; \
+					 uniform mat4 ProjectionView; \
+					 uniform float LeadTime; \
+					 void main() { \
+						vec3 velocity = vec3(VelocityX, 0, VelocityY); \
+						vec3 position = vec3(PositionX, 0, PositionY) + velocity * LeadTime; \
+						vec3 side = vec3(-VelocityY, 0, VelocityX) * 0.1; \
+						vec3 corner = gl_VertexID == 0 ? position + velocity * 0.25 : \
+									  gl_VertexID == 1 ? position - side : position + side; \
+						gl_Position = ProjectionView * vec4(corner, 1); }";
+
+static const char* fsSource = "#version 330\n \
+					 uniform vec4 Colour; \
+					 out vec4 FragColor; \
+					 void main() { FragColor = Colour; }";
+
+EntityRenderer::EntityRenderer()
+	: m_shader(0),
+	m_projectionViewUniform(-1),
+	m_colourUniform(-1),
+	m_leadTimeUniform(-1),
+	m_vao(0),
+	m_vbo(0),
+	m_capacity(0),
+	m_visibleCount(0) {
+}
+
+EntityRenderer::~EntityRenderer() {
+}
+
+bool EntityRenderer::create() {
+	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
+	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
+
+	glShaderSource(vs, 1, (const char**)&vsSource, 0);
+	glCompileShader(vs);
+
+	glShaderSource(fs, 1, (const char**)&fsSource, 0);
+	glCompileShader(fs);
+
+	m_shader = glCreateProgram();
+	glAttachShader(m_shader, vs);
+	glAttachShader(m_shader, fs);
+	glBindAttribLocation(m_shader, ATTRIBUTE_POSITION_X, "PositionX");
+	glBindAttribLocation(m_shader, ATTRIBUTE_POSITION_Y, "PositionY");
+	glBindAttribLocation(m_shader, ATTRIBUTE_VELOCITY_X, "VelocityX");
+	glBindAttribLocation(m_shader, ATTRIBUTE_VELOCITY_Y, "VelocityY");
+	glLinkProgram(m_shader);
+
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+
+	int success = GL_FALSE;
+	glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE) {
+		int infoLogLength = 0;
+		glGetProgramiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
+		char* infoLog = new char[infoLogLength + 1];
+		infoLog[0] = 0;
+
+		glGetProgramInfoLog(m_shader, infoLogLength + 1, 0, infoLog);
+		printf("Error: Failed to link entity shader program!\n%s\n", infoLog);
+		delete[] infoLog;
+
+		destroy();
+		return false;
+	}
+
+	m_projectionViewUniform = RenderState::uniformLocation(m_shader, "ProjectionView");
+	m_colourUniform = RenderState::uniformLocation(m_shader, "Colour");
+	m_leadTimeUniform = RenderState::uniformLocation(m_shader, "LeadTime");
+
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vbo);
+	return true;
+}
+
+void EntityRenderer::destroy() {
+	if (m_vbo != 0)
+		RenderState::deleteBuffer(m_vbo);
+	if (m_vao != 0)
+		RenderState::deleteVertexArray(m_vao);
+	if (m_shader != 0)
+		RenderState::deleteProgram(m_shader);
+	m_vbo = m_vao = m_shader = 0;
+	m_capacity = 0;
+}
+
+void EntityRenderer::reserve(unsigned int count) {
+	if (count <= m_capacity)
+		return;
+
+	// grow geometrically so a slowly rising entity count doesn't reallocate every frame
+	unsigned int capacity = m_capacity > 0 ? m_capacity : 1024;
+	while (capacity < count)
+		capacity *= 2;
+	m_capacity = capacity;
+
+	RenderState::bindVertexArray(m_vao);
+	RenderState::bindArrayBuffer(m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, m_capacity * ATTRIBUTE_COUNT * sizeof(float), nullptr, GL_STREAM_DRAW);
+
+	// every attribute advances once per instance, the three corners come from gl_VertexID
+	for (unsigned int i = 0; i < ATTRIBUTE_COUNT; ++i) {
+		glEnableVertexAttribArray(i);
+		glVertexAttribPointer(i, 1, GL_FLOAT, GL_FALSE, sizeof(float), ((char*)0) + i * m_capacity * sizeof(float));
+		glVertexAttribDivisor(i, 1);
+	}
+}
+
+unsigned int EntityRenderer::cull(const EntityStateBuffer& entities, const Frustum& frustum, float leadTime) {
+	size_t count = entities.size();
+	m_visible.resize(count);
+
+	const float* px = entities.positionX.data();
+	const float* py = entities.positionY.data();
+	const float* vx = entities.velocityX.data();
+	const float* vy = entities.velocityY.data();
+	float* outPx = m_visible.positionX.data();
+	float* outPy = m_visible.positionY.data();
+	float* outVx = m_visible.velocityX.data();
+	float* outVy = m_visible.velocityY.data();
+
+	// entities are on the y = 0 plane, so only each plane's x, z and w matter
+	__m128 planeX[Frustum::PLANE_COUNT], planeZ[Frustum::PLANE_COUNT], planeW[Frustum::PLANE_COUNT];
+	for (int p = 0; p < Frustum::PLANE_COUNT; ++p) {
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	// the arrow's tip is the furthest point from its position, a quarter of the velocity ahead
+	// of wherever the lead time has moved it to
+	const float tipDistance = 0.25f + glm::max(leadTime, 0.0f);
+	const __m128 tipScale = _mm_set1_ps(-tipDistance);
+
+	unsigned int visible = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(px + i);
+		__m128 z = _mm_loadu_ps(py + i);
+		__m128 velocityX = _mm_loadu_ps(vx + i);
+		__m128 velocityZ = _mm_loadu_ps(vy + i);
+		__m128 speedSquared = _mm_add_ps(_mm_mul_ps(velocityX, velocityX), _mm_mul_ps(velocityZ, velocityZ));
+		__m128 negativeRadius = _mm_mul_ps(_mm_sqrt_ps(speedSquared), tipScale);
+
+		__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[0]), _mm_mul_ps(z, planeZ[0])), planeW[0]), negativeRadius);
+		for (int p = 1; p < Frustum::PLANE_COUNT; ++p) {
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(z, planeZ[p])), planeW[p]);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		if (mask == 0)
+			continue;
+		for (int lane = 0; lane < 4; ++lane) {
+			if (mask & (1 << lane)) {
+				outPx[visible] = px[i + lane];
+				outPy[visible] = py[i + lane];
+				outVx[visible] = vx[i + lane];
+				outVy[visible] = vy[i + lane];
+				++visible;
+			}
+		}
+	}
+
+	for (; i < count; ++i) {
+		float radius = tipDistance * sqrtf(vx[i] * vx[i] + vy[i] * vy[i]);
+		if (frustum.intersectsSphere(glm::vec3(px[i], 0, py[i]), radius)) {
+			outPx[visible] = px[i];
+			outPy[visible] = py[i];
+			outVx[visible] = vx[i];
+			outVy[visible] = vy[i];
+			++visible;
+		}
+	}
+	return visible;
+}
+
+void EntityRenderer::draw(const EntityStateBuffer& entities, const glm::mat4& projectionView, const glm::vec4& colour,
+						  const Frustum* frustum /* = nullptr */, float leadTime /* = 0 */) {
+	m_visibleCount = 0;
+	if (m_shader == 0)
+		return;
+
+	const EntityStateBuffer& drawn = frustum != nullptr ? m_visible : entities;
+	unsigned int count = frustum != nullptr ? cull(entities, *frustum, leadTime) : (unsigned int)entities.size();
+	m_visibleCount = count;
+	if (count == 0)
+		return;
+
+	reserve(count);
+
+	const std::vector<float>* streams[ATTRIBUTE_COUNT] = {
+		&drawn.positionX, &drawn.positionY, &drawn.velocityX, &drawn.velocityY };
+
+	// orphan last frame's storage so the upload doesn't wait on a draw still reading it
+	RenderState::bindArrayBuffer(m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, m_capacity * ATTRIBUTE_COUNT * sizeof(float), nullptr, GL_STREAM_DRAW);
+	for (unsigned int i = 0; i < ATTRIBUTE_COUNT; ++i)
+		glBufferSubData(GL_ARRAY_BUFFER, i * m_capacity * sizeof(float), count * sizeof(float), streams[i]->data());
+
+	RenderState::useProgram(m_shader);
+	glUniformMatrix4fv(m_projectionViewUniform, 1, false, glm::value_ptr(projectionView));
+	glUniform4fv(m_colourUniform, 1, glm::value_ptr(colour));
+	glUniform1f(m_leadTimeUniform, leadTime);
+
+	RenderState::bindVertexArray(m_vao);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 3, count);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "EntityState.h"
+#include <glm/fwd.hpp>
+
+struct Frustum;
+
+// draws every entity as an arrow with a single instanced draw call, only position and
+// velocity are uploaded per entity and the vertex shader expands them into the triangle
+// needs GL 3.3 for instanced attributes, which is what createWindow asks for
+class EntityRenderer {
+public:
+
+	EntityRenderer();
+	~EntityRenderer();
+
+	// needs a current GL context
+	bool	create();
+	void	destroy();
+
+	// with a frustum only the entities that can be seen are uploaded and drawn
+	// leadTime moves every entity that many seconds along its velocity, which is how a draw between
+	// two fixed updates is interpolated without keeping the state from before the last one
+	void	draw(const EntityStateBuffer& entities, const glm::mat4& projectionView, const glm::vec4& colour,
+				 const Frustum* frustum = nullptr, float leadTime = 0);
+
+	// entities drawn by the last draw, after culling
+	unsigned int	getVisibleCount() const		{ return m_visibleCount; }
+
+private:
+
+	// grows the instance buffer to fit at least count entities
+	void	reserve(unsigned int count);
+
+	// copies the entities whose arrow can touch the frustum into m_visible, returns how many
+	unsigned int	cull(const EntityStateBuffer& entities, const Frustum& frustum, float leadTime);
+
+	unsigned int	m_shader;
+	int				m_projectionViewUniform;
+	int				m_colourUniform;
+	int				m_leadTimeUniform;
+
+	// one float stream per attribute, laid out like EntityStateBuffer so each is a single upload
+	unsigned int	m_vao;
+	unsigned int	m_vbo;
+	unsigned int	m_capacity;
+
+	EntityStateBuffer	m_visible;
+	unsigned int		m_visibleCount;
+};
@@ -0,0 +1,206 @@
+#include "EntityState.h"
+#include <cmath>
+
+static const unsigned int NO_ENTITY = 0xffffffff;
+
+void EntityStateBuffer::resize(size_t count) {
+	positionX.resize(count);
+	positionY.resize(count);
+	velocityX.resize(count);
+	velocityY.resize(count);
+}
+
+void EntityStateBuffer::push(const AIEntity& entity) {
+	positionX.push_back(entity.position.x);
+	positionY.push_back(entity.position.y);
+	velocityX.push_back(entity.velocity.x);
+	velocityY.push_back(entity.velocity.y);
+}
+
+void EntityStateBuffer::set(size_t index, const AIEntity& entity) {
+	positionX[index] = entity.position.x;
+	positionY[index] = entity.position.y;
+	velocityX[index] = entity.velocity.x;
+	velocityY[index] = entity.velocity.y;
+}
+
+void EntityStateBuffer::removeSwap(size_t index) {
+	size_t last = size() - 1;
+	positionX[index] = positionX[last];
+	positionY[index] = positionY[last];
+	velocityX[index] = velocityX[last];
+	velocityY[index] = velocityY[last];
+	resize(last);
+}
+
+EntityState::EntityState()
+	: m_current(0) {
+}
+
+void EntityState::reset(const AIEntity* entities, size_t count) {
+	load(entities, count);
+	m_buffers[m_current ^ 1] = m_buffers[m_current];
+}
+
+void EntityState::load(const AIEntity* entities, size_t count) {
+	EntityStateBuffer& out = back();
+	out.resize(count);
+	bool sameIds = m_ids.size() == count;
+	m_ids.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		sameIds = sameIds && m_ids[i] == entities[i].id;
+		m_ids[i] = entities[i].id;
+		out.positionX[i] = entities[i].position.x;
+		out.positionY[i] = entities[i].position.y;
+		out.velocityX[i] = entities[i].velocity.x;
+		out.velocityY[i] = entities[i].velocity.y;
+	}
+	swap();
+
+	// the co-simulation loads every frame, but its entities hardly ever change
+	if (sameIds == false)
+		rebuildLookup();
+}
+
+void EntityState::spawn(const AIEntity& entity) {
+	size_t index = indexOf(entity.id);
+	if (index != SlotMap<AIEntity>::npos) {
+		m_buffers[0].set(index, entity);
+		m_buffers[1].set(index, entity);
+		return;
+	}
+
+	// both buffers, so previous() stays the same size as current()
+	m_buffers[0].push(entity);
+	m_buffers[1].push(entity);
+	m_ids.push_back(entity.id);
+
+	unsigned int slot = slotIndex(entity.id);
+	if (slot >= m_lookup.size())
+		m_lookup.resize(slot + 1, NO_ENTITY);
+	m_lookup[slot] = (unsigned int)(m_ids.size() - 1);
+}
+
+void EntityState::despawn(unsigned int id) {
+	size_t index = indexOf(id);
+	if (index == SlotMap<AIEntity>::npos)
+		return;
+
+	m_buffers[0].removeSwap(index);
+	m_buffers[1].removeSwap(index);
+
+	m_lookup[slotIndex(id)] = NO_ENTITY;
+	m_ids[index] = m_ids.back();
+	m_ids.pop_back();
+	if (index < m_ids.size())
+		m_lookup[slotIndex(m_ids[index])] = (unsigned int)index;
+}
+
+size_t EntityState::indexOf(unsigned int id) const {
+	unsigned int slot = slotIndex(id);
+	if (slot >= m_lookup.size() || m_lookup[slot] == NO_ENTITY)
+		return SlotMap<AIEntity>::npos;
+	unsigned int index = m_lookup[slot];
+	return m_ids[index] == id ? index : SlotMap<AIEntity>::npos;
+}
+
+void EntityState::rebuildLookup() {
+	m_lookup.assign(m_lookup.size(), NO_ENTITY);
+	for (size_t i = 0; i < m_ids.size(); ++i) {
+		unsigned int slot = slotIndex(m_ids[i]);
+		if (slot >= m_lookup.size())
+			m_lookup.resize(slot + 1, NO_ENTITY);
+		m_lookup[slot] = (unsigned int)i;
+	}
+}
+
+bool EntityState::matchesOrder(const AIEntity* snapshot, size_t count) const {
+	if (count != m_ids.size())
+		return false;
+	for (size_t i = 0; i < count; ++i) {
+		if (snapshot[i].id != m_ids[i])
+			return false;
+	}
+	return true;
+}
+
+void EntityState::extrapolate(float deltaTime, float smoothness) {
+	const EntityStateBuffer& in = current();
+	EntityStateBuffer& out = back();
+	size_t count = in.size();
+	out.resize(count);
+
+	// low passing towards the extrapolated position only moves a fraction of the step,
+	// and the velocity is filtered against itself so it carries over unchanged
+	const float step = deltaTime * smoothness;
+
+	const float* __restrict px = in.positionX.data();
+	const float* __restrict py = in.positionY.data();
+	const float* __restrict vx = in.velocityX.data();
+	const float* __restrict vy = in.velocityY.data();
+	float* __restrict outPx = out.positionX.data();
+	float* __restrict outPy = out.positionY.data();
+	float* __restrict outVx = out.velocityX.data();
+	float* __restrict outVy = out.velocityY.data();
+
+	for (size_t i = 0; i < count; ++i) {
+		outPx[i] = px[i] + vx[i] * step;
+		outPy[i] = py[i] + vy[i] * step;
+		outVx[i] = vx[i];
+		outVy[i] = vy[i];
+	}
+
+	swap();
+}
+
+void EntityState::filter(const AIEntity* snapshot, size_t count, float smoothness, float teleportDistance) {
+	const EntityStateBuffer& in = current();
+	EntityStateBuffer& out = back();
+	out.resize(in.size());
+
+	const float* __restrict px = in.positionX.data();
+	const float* __restrict py = in.positionY.data();
+	const float* __restrict vx = in.velocityX.data();
+	const float* __restrict vy = in.velocityY.data();
+	float* __restrict outPx = out.positionX.data();
+	float* __restrict outPy = out.positionY.data();
+	float* __restrict outVx = out.velocityX.data();
+	float* __restrict outVy = out.velocityY.data();
+
+	if (matchesOrder(snapshot, count)) {
+		for (size_t i = 0; i < count; ++i) {
+			const AIEntity& raw = snapshot[i];
+
+			// branch free so the loop vectorises, teleported entities take the whole delta
+			float dx = raw.position.x - px[i];
+			float dy = raw.position.y - py[i];
+			float k = (std::abs(dx) < teleportDistance && std::abs(dy) < teleportDistance) ? smoothness : 1.0f;
+
+			outPx[i] = px[i] + k * dx;
+			outPy[i] = py[i] + k * dy;
+			outVx[i] = vx[i] + k * (raw.velocity.x - vx[i]);
+			outVy[i] = vy[i] + k * (raw.velocity.y - vy[i]);
+		}
+	}
+	else {
+		// membership or order differs, carry everything over then filter what the snapshot has
+		out = in;
+		for (size_t s = 0; s < count; ++s) {
+			const AIEntity& raw = snapshot[s];
+			size_t i = indexOf(raw.id);
+			if (i == SlotMap<AIEntity>::npos)
+				continue;
+
+			float dx = raw.position.x - px[i];
+			float dy = raw.position.y - py[i];
+			float k = (std::abs(dx) < teleportDistance && std::abs(dy) < teleportDistance) ? smoothness : 1.0f;
+
+			out.positionX[i] = px[i] + k * dx;
+			out.positionY[i] = py[i] + k * dy;
+			out.velocityX[i] = vx[i] + k * (raw.velocity.x - vx[i]);
+			out.velocityY[i] = vy[i] + k * (raw.velocity.y - vy[i]);
+		}
+	}
+
+	swap();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "AIEntity.h"
+#include "SlotMap.h"
+#include <vector>
+
+// structure-of-arrays entity state, so the filter passes run over contiguous floats
+struct EntityStateBuffer {
+	std::vector<float>	positionX;
+	std::vector<float>	positionY;
+	std::vector<float>	velocityX;
+	std::vector<float>	velocityY;
+
+	size_t	size() const	{ return positionX.size(); }
+	void	resize(size_t count);
+
+	void	push(const AIEntity& entity);
+	void	set(size_t index, const AIEntity& entity);
+
+	// moves the last entity into index and shrinks by one
+	void	removeSwap(size_t index);
+};
+
+// the client's filtered entities, double-buffered so each pass reads the previous
+// frame's result and writes the other buffer, then swaps index instead of copying
+// entities are keyed by the server's generational handle, which the slot index part
+// of looks up directly, so spawns and despawns are O(1)
+class EntityState {
+public:
+
+	EntityState();
+
+	size_t	size() const	{ return m_buffers[m_current].size(); }
+
+	// starts over from the given entities, both buffers hold them
+	void	reset(const AIEntity* entities, size_t count);
+
+	// replaces the state with unfiltered entities, e.g. from the co-simulation
+	void	load(const AIEntity* entities, size_t count);
+
+	// membership changes from ID_ENTITY_EVENTS, spawning a known id just resets its state
+	void	spawn(const AIEntity& entity);
+	void	despawn(unsigned int id);
+
+	// dense index of the entity, or SlotMap<AIEntity>::npos if it isn't known
+	size_t	indexOf(unsigned int id) const;
+
+	// moves every entity along its velocity, smoothed against the previous frame
+	void	extrapolate(float deltaTime, float smoothness);
+
+	// low pass filters towards a newer snapshot, entities that moved further than
+	// teleportDistance on either axis jump straight to the snapshot
+	// snapshot entities that aren't known yet are skipped, known ones missing from it are kept
+	void	filter(const AIEntity* snapshot, size_t count, float smoothness, float teleportDistance);
+
+	const EntityStateBuffer&	current() const		{ return m_buffers[m_current]; }
+	const EntityStateBuffer&	previous() const	{ return m_buffers[m_current ^ 1]; }
+
+	// ids don't change from frame to frame, so they aren't double-buffered
+	const std::vector<unsigned int>&	ids() const	{ return m_ids; }
+
+private:
+
+	EntityStateBuffer&	back()	{ return m_buffers[m_current ^ 1]; }
+	void				swap()	{ m_current ^= 1; }
+
+	void	rebuildLookup();
+
+	// the common case, the snapshot holds exactly our entities in our order
+	bool	matchesOrder(const AIEntity* snapshot, size_t count) const;
+
+	EntityStateBuffer			m_buffers[2];
+	unsigned int				m_current;
+	std::vector<unsigned int>	m_ids;
+
+	// dense index by slot index of the id, checked against m_ids since slots are reused
+	std::vector<unsigned int>	m_lookup;
+};
@@ -0,0 +1,28 @@
+#include "Frustum.h"
+#include <glm/glm.hpp>
+
+void Frustum::extract(const glm::mat4& projectionView) {
+	// rows of the matrix, clip space is inside where -w <= x,y,z <= w
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; ++i)
+		row[i] = glm::vec4(projectionView[0][i], projectionView[1][i], projectionView[2][i], projectionView[3][i]);
+
+	planes[PLANE_LEFT] = row[3] + row[0];
+	planes[PLANE_RIGHT] = row[3] - row[0];
+	planes[PLANE_BOTTOM] = row[3] + row[1];
+	planes[PLANE_TOP] = row[3] - row[1];
+	planes[PLANE_NEAR] = row[3] + row[2];
+	planes[PLANE_FAR] = row[3] - row[2];
+
+	// normalised so the distance to a plane can be compared against a radius
+	for (auto& plane : planes)
+		plane /= glm::length(glm::vec3(plane.x, plane.y, plane.z));
+}
+
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const {
+	for (const auto& plane : planes) {
+		if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+// the six clip planes of a projection view matrix, normalised with their normals pointing
+// inwards, so a point is inside when dot(plane.xyz, point) + plane.w >= 0 for every plane
+struct Frustum {
+
+	enum {
+		PLANE_LEFT,
+		PLANE_RIGHT,
+		PLANE_BOTTOM,
+		PLANE_TOP,
+		PLANE_NEAR,
+		PLANE_FAR,
+		PLANE_COUNT,
+	};
+
+	glm::vec4	planes[PLANE_COUNT];
+
+	void	extract(const glm::mat4& projectionView);
+
+	// conservative, a sphere near a corner can pass while being just outside
+	bool	intersectsSphere(const glm::vec3& center, float radius) const;
+};
@@ -1,161 +1,196 @@
+// before Gizmos.h, whose glm includes would otherwise come first without swizzling
+#define GLM_SWIZZLE
 #include "Gizmos.h"
 #include "gl_core_4_4.h"
-#define GLM_SWIZZLE
+#include "RenderState.h"
+#include "Camera.h"
+#include "Profiler.h"
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
+#include <emmintrin.h>
+#include <cstring>
 
 Gizmos* Gizmos::sm_singleton = nullptr;
+unsigned int Gizmos::sm_instances = 0;
+thread_local Gizmos::ThreadContext Gizmos::sm_threadContext = { 0, 0, nullptr };
 
-Gizmos::Gizmos(unsigned int a_maxLines, unsigned int a_maxTris,
-			   unsigned int a_max2DLines, unsigned int a_max2DTris)
-	: m_maxLines(a_maxLines),
-	m_lineCount(0),
-	m_lines(new GizmoLine[a_maxLines]),
-	m_maxTris(a_maxTris),
-	m_triCount(0),
-	m_tris(new GizmoTri[a_maxTris]),
-	m_transparentTriCount(0),
-	m_transparentTris(new GizmoTri[a_maxTris]),
-	m_max2DLines(a_max2DLines),
-	m_2DlineCount(0),
-	m_2Dlines(new GizmoLine[a_max2DLines]),
-	m_max2DTris(a_max2DTris),
-	m_2DtriCount(0),
-	m_2Dtris(new GizmoTri[a_max2DTris]) {
-	// create shaders
-	const char* vsSource = "#version 150\n \
-					 in vec4 Position; \
-					 in vec4 Colour; \
-					 out vec4 vColour; \
-					 uniform mat4 ProjectionView; \
-					 void main() { vColour = Colour; gl_Position = ProjectionView * Position; }";
+// a shape's level only changes once its ideal level is this far past the edge of the one it had,
+// so anything sitting on a boundary doesn't flicker between the two every frame
+static const float LOD_HYSTERESIS = 0.25f;
 
-	const char* fsSource = "#version 150\n \
-					 in vec4 vColour; \
-                     out vec4 FragColor; \
-					 void main()	{ FragColor = vColour; }";
-    
-    
+// the largest scale along any axis of a transform that's only meant to rotate
+static float transformScale(const glm::mat4& a_transform) {
+	return glm::max(glm::length(a_transform[0].xyz()),
+		   glm::max(glm::length(a_transform[1].xyz()), glm::length(a_transform[2].xyz())));
+}
+
+// rounds a [0,1] colour channel to a normalised byte
+static unsigned char packChannel(float a_value) {
+	a_value = a_value < 0 ? 0 : (a_value > 1 ? 1 : a_value);
+	return (unsigned char)(a_value * 255.0f + 0.5f);
+}
+
+// compiles and links, binding a_attributes to locations in order
+static unsigned int createProgram(const char* a_vsSource, const char* a_fsSource,
+								  const char* const* a_attributes, unsigned int a_attributeCount) {
 	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
 	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
 
-	glShaderSource(vs, 1, (const char**)&vsSource, 0);
+	glShaderSource(vs, 1, (const char**)&a_vsSource, 0);
 	glCompileShader(vs);
 
-	glShaderSource(fs, 1, (const char**)&fsSource, 0);
+	glShaderSource(fs, 1, (const char**)&a_fsSource, 0);
 	glCompileShader(fs);
 
-	m_shader = glCreateProgram();
-	glAttachShader(m_shader, vs);
-	glAttachShader(m_shader, fs);
-	glBindAttribLocation(m_shader, 0, "Position");
-	glBindAttribLocation(m_shader, 1, "Colour");
-	glLinkProgram(m_shader);
-    
+	unsigned int program = glCreateProgram();
+	glAttachShader(program, vs);
+	glAttachShader(program, fs);
+	for (unsigned int i = 0; i < a_attributeCount; ++i)
+		glBindAttribLocation(program, i, a_attributes[i]);
+	glLinkProgram(program);
+
 	int success = GL_FALSE;
-    glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
 	if (success == GL_FALSE)
 	{
 		int infoLogLength = 0;
-		glGetShaderiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
-		char* infoLog = new char[infoLogLength];
-        
-		glGetShaderInfoLog(m_shader, infoLogLength, 0, infoLog);
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
+		char* infoLog = new char[infoLogLength + 1];
+		infoLog[0] = 0;
+
+		glGetProgramInfoLog(program, infoLogLength + 1, 0, infoLog);
 		printf("Error: Failed to link Gizmo shader program!\n%s\n", infoLog);
 		delete[] infoLog;
 	}
 
 	glDeleteShader(vs);
 	glDeleteShader(fs);
-    
-    // create VBOs
-	glGenBuffers( 1, &m_lineVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxLines * sizeof(GizmoLine), m_lines, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_triVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_triVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxTris * sizeof(GizmoTri), m_tris, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_transparentTriVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_transparentTriVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxTris * sizeof(GizmoTri), m_transparentTris, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_2DlineVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DlineVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_max2DLines * sizeof(GizmoLine), m_2Dlines, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_2DtriVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DtriVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_max2DTris * sizeof(GizmoTri), m_2Dtris, GL_DYNAMIC_DRAW);
-
-	glGenVertexArrays(1, &m_lineVAO);
-	glBindVertexArray(m_lineVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), ((char*)0) + 16);
+	return program;
+}
 
-	glGenVertexArrays(1, &m_triVAO);
-	glBindVertexArray(m_triVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_triVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), ((char*)0) + 16);
+Gizmos::Gizmos(unsigned int a_maxLines, unsigned int a_maxTris,
+			   unsigned int a_max2DLines, unsigned int a_max2DTris,
+			   VertexFormat a_format, bool a_deferred)
+	: m_format(a_format),
+	m_vertexSize(a_format == VERTEX_PACKED ? sizeof(PackedGizmoVertex) : sizeof(GizmoVertex)),
+	m_persistent(false),
+	m_frame(0),
+	m_drawnFence(nullptr),
+	m_instance(++sm_instances),
+	m_epoch(0),
+	m_chunks(0),
+	m_deferred(a_deferred),
+	m_cleared(false),
+	m_shapeMeshCount(0),
+	m_camera(nullptr),
+	m_lodViewportHeight(0),
+	m_lodSegmentPixels(0) {
+	for (auto& fence : m_fences)
+		fence = nullptr;
+	m_lastStats = Stats{ 0, 0, 0, 0, 0, 0, 0 };
 
-	glGenVertexArrays(1, &m_transparentTriVAO);
-	glBindVertexArray(m_transparentTriVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_transparentTriVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), ((char*)0) + 16);
+	// create shaders
+	const char* vsSource = "#version 150\n \
+					 in vec4 Position; \
+					 in vec4 Colour; \
+					 out vec4 vColour; \
+					 uniform mat4 ProjectionView; \
+					 void main() { vColour = Colour; gl_Position = ProjectionView * Position; }";
 
-	glGenVertexArrays(1, &m_2DlineVAO);
-	glBindVertexArray(m_2DlineVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DlineVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), ((char*)0) + 16);
+	const char* fsSource = "#version 150\n \
+					 in vec4 vColour; \
+                     out vec4 FragColor; \
+					 void main()	{ FragColor = vColour; }";
 
-	glGenVertexArrays(1, &m_2DtriVAO);
-	glBindVertexArray(m_2DtriVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DtriVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), ((char*)0) + 16);
+	const char* attributes[] = { "Position", "Colour" };
+	m_shader = createProgram(vsSource, fsSource, attributes, 2);
+	m_projectionViewUniform = RenderState::uniformLocation(m_shader, "ProjectionView");
+
+	// unit meshes, the instance transform's rows are dotted with the scaled unit position
+	const char* shapeVsSource = "#version 330\n \
+					 in vec4 Unit; \
+					 in vec4 Row0; \
+					 in vec4 Row1; \
+					 in vec4 Row2; \
+					 in vec2 Params; \
+					 in vec4 Colour; \
+					 out vec4 vColour; \
+					 uniform mat4 ProjectionView; \
+					 void main() { \
+						vec4 local = vec4(Unit.xyz * mix(Params.x, Params.y, Unit.w), 1); \
+						vec3 world = vec3(dot(Row0, local), dot(Row1, local), dot(Row2, local)); \
+						vColour = Colour; gl_Position = ProjectionView * vec4(world, 1); }";
+
+	const char* shapeAttributes[] = { "Unit", "Row0", "Row1", "Row2", "Params", "Colour" };
+	m_shapeShader = createProgram(shapeVsSource, fsSource, shapeAttributes, 6);
+	m_shapeProjectionViewUniform = RenderState::uniformLocation(m_shapeShader, "ProjectionView");
+    
+	// VBOs are persistently mapped if the context is new enough, the threads adding to deferred
+	// Gizmos don't have it, so they stage and acquire maps their frames once draw is done with them
+	// ogl_IsVersionGEQ is backwards, true when the context is older than asked, so compare by hand
+	int version = ogl_GetMajorVersion() * 10 + ogl_GetMinorVersion();
+	m_persistent = glBufferStorage != nullptr && version >= 44;
+
+	m_chunkSizes[LINES] = a_maxLines;
+	m_chunkSizes[TRIS] = a_maxTris;
+	m_chunkSizes[TRANSPARENT_TRIS] = a_maxTris;
+	m_chunkSizes[LINES_2D] = a_max2DLines;
+	m_chunkSizes[TRIS_2D] = a_max2DTris;
+
+	// the creating thread's context is always first, the only one that can be mapped
+	context();
+	if (m_deferred)
+	{
+		for (unsigned int i = 0; i < TripleBuffer<std::vector<Frame>>::COUNT; ++i)
+		{
+			m_frames.buffer(i).resize(1);
+			initFrame(m_frames.buffer(i)[0], false);
+		}
+	}
 
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_deferredRecording.removed = false;
+	glGenBuffers(1, &m_shapeVBO);
+
+	RenderState::bindVertexArray(0);
+	RenderState::bindArrayBuffer(0);
 }
 
 Gizmos::~Gizmos() {
-	delete[] m_lines;
-	delete[] m_tris;
-	delete[] m_transparentTris;
-	glDeleteBuffers( 1, &m_lineVBO );
-	glDeleteBuffers( 1, &m_triVBO );
-	glDeleteBuffers( 1, &m_transparentTriVBO );
-	glDeleteVertexArrays( 1, &m_lineVAO );
-	glDeleteVertexArrays( 1, &m_triVAO );
-	glDeleteVertexArrays( 1, &m_transparentTriVAO );
-	delete[] m_2Dlines;
-	delete[] m_2Dtris;
-	glDeleteBuffers( 1, &m_2DlineVBO );
-	glDeleteBuffers( 1, &m_2DtriVBO );
-	glDeleteVertexArrays( 1, &m_2DlineVAO );
-	glDeleteVertexArrays( 1, &m_2DtriVAO );
-	glDeleteProgram(m_shader);
+	// deleting a buffer unmaps it
+	for (auto fence : m_fences)
+		glDeleteSync((GLsync)fence);
+	glDeleteSync((GLsync)m_drawnFence);
+
+	for (Context* context : m_contexts)
+	{
+		destroyFrame(context->frame);
+		delete context;
+	}
+	if (m_deferred)
+	{
+		for (unsigned int i = 0; i < TripleBuffer<std::vector<Frame>>::COUNT; ++i)
+		{
+			for (auto& frame : m_frames.buffer(i))
+				destroyFrame(frame);
+		}
+	}
+	for (auto& batch : m_staticBatches)
+		destroyStatic(batch);
+	for (unsigned int i = 0; i < m_shapeMeshCount; ++i)
+	{
+		RenderState::deleteBuffer(m_shapeMeshes[i].vbo);
+		RenderState::deleteVertexArray(m_shapeMeshes[i].vao);
+	}
+	RenderState::deleteBuffer(m_shapeVBO);
+	RenderState::deleteProgram(m_shapeShader);
+	RenderState::deleteProgram(m_shader);
 }
 
 void Gizmos::create(unsigned int a_maxLines /* = 0xffff */, unsigned int a_maxTris /* = 0xffff */,
-					unsigned int a_max2DLines /* = 0xff */, unsigned int a_max2DTris /* = 0xff */) {
+					unsigned int a_max2DLines /* = 0xff */, unsigned int a_max2DTris /* = 0xff */,
+					VertexFormat a_format /* = VERTEX_FLOAT */, bool a_deferred /* = false */) {
 	if (sm_singleton == nullptr)
-		sm_singleton = new Gizmos(a_maxLines,a_maxTris,a_max2DLines,a_max2DTris);
+		sm_singleton = new Gizmos(a_maxLines,a_maxTris,a_max2DLines,a_max2DTris,a_format,a_deferred);
 }
 
 void Gizmos::destroy() {
@@ -163,17 +198,1031 @@ void Gizmos::destroy() {
 	sm_singleton = nullptr;
 }
 
+void Gizmos::setCamera(const Camera* a_camera) {
+	if (sm_singleton != nullptr)
+		sm_singleton->m_camera = a_camera;
+}
+
+bool Gizmos::culled(const glm::vec3& a_center, float a_radius, const glm::mat4* a_transform) {
+	// static batches are kept for later frames, so whatever is off screen now still belongs in them
+	Context& context = this->context();
+	if (m_camera == nullptr || context.recording != nullptr)
+		return false;
+
+	// the transform is only meant to rotate, but may scale as well
+	if (a_transform != nullptr)
+		a_radius *= transformScale(*a_transform);
+
+	if (m_camera->getFrustum().intersectsSphere(a_center, a_radius))
+		return false;
+
+	++context.frame.stats.culled;
+	return true;
+}
+
+void Gizmos::setLevelOfDetail(float a_viewportHeight, float a_segmentPixels /* = 8 */) {
+	if (sm_singleton != nullptr)
+	{
+		sm_singleton->m_lodViewportHeight = a_viewportHeight;
+		sm_singleton->m_lodSegmentPixels = a_segmentPixels;
+	}
+}
+
+unsigned int Gizmos::lodLevel(const glm::vec3& a_center, float a_length, const glm::mat4* a_transform,
+							  unsigned int a_segments, unsigned int a_minSegments) {
+	Context& context = this->context();
+	if (m_camera == nullptr || m_lodSegmentPixels <= 0 || context.recording != nullptr)
+		return 0;
+
+	unsigned int maxLevel = 0;
+	while ((a_segments >> (maxLevel + 1)) >= a_minSegments)
+		++maxLevel;
+
+	if (a_transform != nullptr)
+		a_length *= transformScale(*a_transform);
+
+	// projected the same way as the centre, so perspective shrinks it with distance
+	float depth = -(m_camera->getView() * glm::vec4(a_center, 1)).z;
+	float ideal = 0;
+	if (depth > 0)
+	{
+		float pixels = a_length * m_camera->getProjection()[1][1] * 0.5f * m_lodViewportHeight / depth;
+		float wanted = glm::max(pixels / m_lodSegmentPixels, 1.0f);
+		ideal = glm::log2(a_segments / wanted);
+	}
+
+	size_t index = context.lodLevels.size();
+	unsigned int level;
+	if (index < context.lodPrevious.size() &&
+		ideal > context.lodPrevious[index] - LOD_HYSTERESIS &&
+		ideal < context.lodPrevious[index] + 1 + LOD_HYSTERESIS)
+		level = context.lodPrevious[index];
+	else
+		level = ideal > 0 ? (unsigned int)ideal : 0;
+	level = glm::min(level, maxLevel);
+
+	context.lodLevels.push_back((unsigned char)level);
+	if (level > 0)
+		++context.frame.stats.reduced;
+	return level;
+}
+
+Gizmos::Context& Gizmos::context() {
+	ThreadContext& cached = sm_threadContext;
+	if (cached.instance == m_instance)
+	{
+		if (cached.epoch == m_epoch)
+			return *cached.context;
+
+		// still free if no other thread has taken it since this one last did
+		unsigned int expected = cached.epoch;
+		if (cached.context->epoch.compare_exchange_strong(expected, m_epoch))
+		{
+			cached.epoch = m_epoch;
+			return *cached.context;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_contextMutex);
+	Context* context = nullptr;
+
+	// the creating thread's is never handed to another, it may be mapped and only that thread has the GL context
+	for (size_t i = 1; i < m_contexts.size() && context == nullptr; ++i)
+	{
+		unsigned int expected = m_contexts[i]->epoch;
+		if (expected != m_epoch && m_contexts[i]->epoch.compare_exchange_strong(expected, m_epoch))
+			context = m_contexts[i];
+	}
+
+	if (context == nullptr)
+	{
+		context = new Context();
+		context->epoch = m_epoch;
+		initFrame(context->frame, m_persistent && m_deferred == false && m_contexts.empty());
+		context->recording = nullptr;
+		m_contexts.push_back(context);
+	}
+
+	cached.instance = m_instance;
+	cached.epoch = m_epoch;
+	cached.context = context;
+	return *context;
+}
+
+Gizmos::Stats Gizmos::sumStats(const std::vector<Frame*>& a_frames) const {
+	// chunks are counted once for every frame
+	Stats total = { 0, 0, 0, 0, m_chunks, 0, 0 };
+	for (const Frame* frame : a_frames)
+	{
+		total.primitives += frame->stats.primitives;
+		total.dropped += frame->stats.dropped;
+		total.bytesUploaded += frame->stats.bytesUploaded;
+		total.drawCalls += frame->stats.drawCalls;
+		total.culled += frame->stats.culled;
+		total.reduced += frame->stats.reduced;
+	}
+	return total;
+}
+
+const Gizmos::Stats& Gizmos::getStats() {
+	static const Stats none = Stats{ 0, 0, 0, 0, 0, 0, 0 };
+	return sm_singleton != nullptr ? sm_singleton->m_lastStats : none;
+}
+
+void Gizmos::initStream(Stream& a_stream, StreamType a_type, unsigned int a_vertices, bool a_persistent) {
+	a_stream.type = a_type;
+	a_stream.vertices = a_vertices;
+	a_stream.chunkSize = m_chunkSizes[a_type] > 0 ? m_chunkSizes[a_type] : 1;
+	a_stream.count = 0;
+	a_stream.current = 0;
+	a_stream.uploaded = false;
+	a_stream.persistent = a_persistent;
+
+	// descriptors only, but reserved so growing never copies them either
+	a_stream.chunks.reserve(MAX_CHUNKS);
+	addChunk(a_stream);
+}
+
+void Gizmos::destroyStream(Stream& a_stream) {
+	for (auto& chunk : a_stream.chunks)
+	{
+		if (chunk.mapped == false)
+			delete[] (unsigned char*)chunk.storage;
+		RenderState::deleteBuffer(chunk.vbo);
+		RenderState::deleteVertexArray(chunk.vao);
+	}
+	a_stream.chunks.clear();
+}
+
+bool Gizmos::addChunk(Stream& a_stream) {
+	if (a_stream.chunks.size() >= MAX_CHUNKS)
+		return false;
+
+	const size_t bytes = (size_t)a_stream.chunkSize * a_stream.vertices * m_vertexSize;
+
+	Chunk chunk;
+	chunk.count = 0;
+	chunk.vao = 0;
+	chunk.vbo = 0;
+	chunk.mapped = a_stream.persistent;
+	if (a_stream.persistent)
+	{
+		chunk.storage = createPersistentBuffer(chunk.vbo, bytes, FRAME_COUNT);
+		chunk.data = (unsigned char*)chunk.storage + m_frame * bytes;
+		setupVertexArray(chunk.vao, chunk.vbo);
+
+		RenderState::bindVertexArray(0);
+		RenderState::bindArrayBuffer(0);
+	}
+	else
+	{
+		// the buffers are made when it's first drawn, as the thread adding it may not have the context
+		chunk.storage = new unsigned char[bytes];
+		chunk.data = (unsigned char*)chunk.storage;
+	}
+
+	a_stream.chunks.push_back(chunk);
+	++m_chunks;
+	return true;
+}
+
+void Gizmos::createChunkBuffers(Stream& a_stream, Chunk& a_chunk) {
+	glGenBuffers(1, &a_chunk.vbo);
+	RenderState::bindArrayBuffer(a_chunk.vbo);
+	glBufferData(GL_ARRAY_BUFFER, (size_t)a_stream.chunkSize * a_stream.vertices * m_vertexSize, nullptr, GL_DYNAMIC_DRAW);
+	setupVertexArray(a_chunk.vao, a_chunk.vbo);
+
+	RenderState::bindVertexArray(0);
+	RenderState::bindArrayBuffer(0);
+}
+
+unsigned char* Gizmos::allocate(StreamType a_type) {
+	size_t granted;
+	return reserve(a_type, 1, granted);
+}
+
+unsigned char* Gizmos::reserve(StreamType a_type, size_t a_count, size_t& a_granted) {
+	Context& context = this->context();
+	Stream& stream = context.frame.streams[a_type];
+	const size_t primitiveBytes = stream.vertices * m_vertexSize;
+
+	if (context.recording != nullptr)
+	{
+		std::vector<unsigned char>& recording = context.recording->buffers[a_type].recording;
+		size_t offset = recording.size();
+		recording.resize(offset + a_count * primitiveBytes);
+		a_granted = a_count;
+		return recording.data() + offset;
+	}
+
+	Chunk* chunk = &stream.chunks[stream.current];
+	if (chunk->count == stream.chunkSize)
+	{
+		// move on to the next chunk, creating it the first time a frame needs it
+		if (stream.current + 1 == stream.chunks.size() &&
+			addChunk(stream) == false)
+		{
+			context.frame.stats.dropped += (unsigned int)a_count;
+			a_granted = 0;
+			return nullptr;
+		}
+		chunk = &stream.chunks[++stream.current];
+	}
+
+	a_granted = stream.chunkSize - chunk->count;
+	if (a_granted > a_count)
+		a_granted = a_count;
+
+	unsigned char* data = chunk->data + chunk->count * primitiveBytes;
+	chunk->count += (unsigned int)a_granted;
+	stream.count += (unsigned int)a_granted;
+	context.frame.stats.primitives += (unsigned int)a_granted;
+	return data;
+}
+
+// a packed vertex's xyz and colour bytes as one 16 byte value, the colour stays in integer
+// registers so no bit pattern can be altered on the way
+static __m128i packVertex(const glm::vec3& a_position, int a_colour) {
+	__m128i position = _mm_castps_si128(_mm_setr_ps(a_position.x, a_position.y, a_position.z, 0));
+	return _mm_or_si128(position, _mm_setr_epi32(0, 0, 0, a_colour));
+}
+
+static int packColour(const glm::vec4& a_colour) {
+	unsigned char bytes[4] = { packChannel(a_colour.r), packChannel(a_colour.g), packChannel(a_colour.b), packChannel(a_colour.a) };
+	int packed;
+	memcpy(&packed, bytes, sizeof(packed));
+	return packed;
+}
+
+// each vertex is one or two unaligned 16 byte stores, the format is picked once per array rather than per vertex
+void Gizmos::writeLines(unsigned char* a_dst, const LineDesc* a_lines, size_t a_count) const {
+	float* dst = (float*)a_dst;
+	if (m_format == VERTEX_PACKED)
+	{
+		for (size_t i = 0; i < a_count; ++i, dst += 8)
+		{
+			const LineDesc& line = a_lines[i];
+			int colour = packColour(line.colour);
+			_mm_storeu_si128((__m128i*)dst, packVertex(line.start, colour));
+			_mm_storeu_si128((__m128i*)(dst + 4), packVertex(line.end, colour));
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < a_count; ++i, dst += 16)
+		{
+			const LineDesc& line = a_lines[i];
+			__m128 colour = _mm_loadu_ps(&line.colour.x);
+			_mm_storeu_ps(dst, _mm_setr_ps(line.start.x, line.start.y, line.start.z, 1));
+			_mm_storeu_ps(dst + 4, colour);
+			_mm_storeu_ps(dst + 8, _mm_setr_ps(line.end.x, line.end.y, line.end.z, 1));
+			_mm_storeu_ps(dst + 12, colour);
+		}
+	}
+}
+
+void Gizmos::writeTris(unsigned char* a_dst, const TriDesc* a_tris, size_t a_count) const {
+	float* dst = (float*)a_dst;
+	if (m_format == VERTEX_PACKED)
+	{
+		for (size_t i = 0; i < a_count; ++i, dst += 12)
+		{
+			const TriDesc& tri = a_tris[i];
+			int colour = packColour(tri.colour);
+			_mm_storeu_si128((__m128i*)dst, packVertex(tri.v0, colour));
+			_mm_storeu_si128((__m128i*)(dst + 4), packVertex(tri.v1, colour));
+			_mm_storeu_si128((__m128i*)(dst + 8), packVertex(tri.v2, colour));
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < a_count; ++i, dst += 24)
+		{
+			const TriDesc& tri = a_tris[i];
+			__m128 colour = _mm_loadu_ps(&tri.colour.x);
+			_mm_storeu_ps(dst, _mm_setr_ps(tri.v0.x, tri.v0.y, tri.v0.z, 1));
+			_mm_storeu_ps(dst + 4, colour);
+			_mm_storeu_ps(dst + 8, _mm_setr_ps(tri.v1.x, tri.v1.y, tri.v1.z, 1));
+			_mm_storeu_ps(dst + 12, colour);
+			_mm_storeu_ps(dst + 16, _mm_setr_ps(tri.v2.x, tri.v2.y, tri.v2.z, 1));
+			_mm_storeu_ps(dst + 20, colour);
+		}
+	}
+}
+
+void Gizmos::drawStream(Frame& a_frame, StreamType a_type, unsigned int a_mode) {
+	Stream& stream = a_frame.streams[a_type];
+	for (auto& chunk : stream.chunks)
+	{
+		if (chunk.count == 0)
+			break;
+
+		if (chunk.vbo == 0)
+			createChunkBuffers(stream, chunk);
+
+		// staged data is only uploaded the first time a frame is drawn
+		const unsigned int bytes = chunk.count * stream.vertices * m_vertexSize;
+		if (chunk.mapped == false && stream.uploaded == false)
+		{
+			RenderState::bindArrayBuffer(chunk.vbo);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, chunk.data);
+		}
+		if (chunk.mapped || stream.uploaded == false)
+			a_frame.stats.bytesUploaded += bytes;
+
+		RenderState::bindVertexArray(chunk.vao);
+		glDrawArrays(a_mode, stream.persistent ? m_frame * stream.chunkSize * stream.vertices : 0, chunk.count * stream.vertices);
+		++a_frame.stats.drawCalls;
+	}
+	stream.uploaded = true;
+}
+
+void* Gizmos::createPersistentBuffer(unsigned int& a_vbo, size_t a_bytes, unsigned int a_copies) {
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &a_vbo);
+	RenderState::bindArrayBuffer(a_vbo);
+	glBufferStorage(GL_ARRAY_BUFFER, a_bytes * a_copies, nullptr, flags);
+	return glMapBufferRange(GL_ARRAY_BUFFER, 0, a_bytes * a_copies, flags);
+}
+
+void Gizmos::mapFrame(Frame& a_frame) {
+	for (auto& stream : a_frame.streams)
+	{
+		const size_t bytes = (size_t)stream.chunkSize * stream.vertices * m_vertexSize;
+		for (auto& chunk : stream.chunks)
+		{
+			if (chunk.mapped)
+				continue;
+
+			// the frame may be drawn again before it's handed back, so what was staged comes along
+			unsigned char* staged = (unsigned char*)chunk.storage;
+			RenderState::deleteBuffer(chunk.vbo);
+			RenderState::deleteVertexArray(chunk.vao);
+			chunk.storage = createPersistentBuffer(chunk.vbo, bytes, 1);
+			chunk.data = (unsigned char*)chunk.storage;
+			memcpy(chunk.data, staged, (size_t)chunk.count * stream.vertices * m_vertexSize);
+			delete[] staged;
+			setupVertexArray(chunk.vao, chunk.vbo);
+			chunk.mapped = true;
+		}
+	}
+
+	RenderState::bindVertexArray(0);
+	RenderState::bindArrayBuffer(0);
+}
+
+void Gizmos::beginStatic(const char* a_name) {
+	if (sm_singleton == nullptr || sm_singleton->context().recording != nullptr)
+		return;
+
+	// deferred batches belong to the drawing thread, so they're recorded separately and handed over
+	if (sm_singleton->m_deferred)
+	{
+		StaticBatch& batch = sm_singleton->m_deferredRecording;
+		batch.name = a_name;
+		batch.removed = false;
+		for (auto& buffer : batch.buffers)
+		{
+			buffer.recording.clear();
+			buffer.count = 0;
+			buffer.vao = 0;
+			buffer.vbo = 0;
+		}
+		sm_singleton->context().recording = &batch;
+		return;
+	}
+
+	StaticBatch* batch = sm_singleton->findStatic(a_name);
+	if (batch != nullptr)
+		sm_singleton->destroyStatic(*batch);
+	else
+	{
+		sm_singleton->m_staticBatches.push_back(StaticBatch());
+		batch = &sm_singleton->m_staticBatches.back();
+		batch->name = a_name;
+		batch->removed = false;
+		for (auto& buffer : batch->buffers)
+		{
+			buffer.count = 0;
+			buffer.vao = 0;
+			buffer.vbo = 0;
+		}
+	}
+	sm_singleton->context().recording = batch;
+}
+
+void Gizmos::endStatic() {
+	if (sm_singleton == nullptr || sm_singleton->context().recording == nullptr)
+		return;
+
+	if (sm_singleton->m_deferred)
+	{
+		std::lock_guard<std::mutex> lock(sm_singleton->m_staticMutex);
+		sm_singleton->m_staticChanges.push_back(StaticBatch());
+		std::swap(sm_singleton->m_staticChanges.back(), sm_singleton->m_deferredRecording);
+	}
+	else
+		sm_singleton->uploadStatic(*sm_singleton->context().recording);
+
+	sm_singleton->context().recording = nullptr;
+}
+
+void Gizmos::removeStatic(const char* a_name) {
+	if (sm_singleton == nullptr || sm_singleton->context().recording != nullptr)
+		return;
+
+	if (sm_singleton->m_deferred)
+	{
+		std::lock_guard<std::mutex> lock(sm_singleton->m_staticMutex);
+		sm_singleton->m_staticChanges.push_back(StaticBatch());
+		StaticBatch& removal = sm_singleton->m_staticChanges.back();
+		removal.name = a_name;
+		removal.removed = true;
+		return;
+	}
+
+	auto& batches = sm_singleton->m_staticBatches;
+	for (auto batch = batches.begin(); batch != batches.end(); ++batch)
+	{
+		if (batch->name == a_name)
+		{
+			sm_singleton->destroyStatic(*batch);
+			batches.erase(batch);
+			return;
+		}
+	}
+}
+
+Gizmos::StaticBatch* Gizmos::findStatic(const char* a_name) {
+	for (auto& batch : m_staticBatches)
+	{
+		if (batch.name == a_name)
+			return &batch;
+	}
+	return nullptr;
+}
+
+void Gizmos::uploadStatic(StaticBatch& a_batch) {
+	for (unsigned int type = 0; type < STREAM_TYPES; ++type)
+	{
+		StaticBuffer& buffer = a_batch.buffers[type];
+		if (buffer.recording.empty())
+			continue;
+
+		// not from a context's streams, which may be another thread's when deferred
+		unsigned int vertices = type == LINES || type == LINES_2D ? 2 : 3;
+		buffer.count = (unsigned int)(buffer.recording.size() / (vertices * m_vertexSize));
+
+		glGenBuffers(1, &buffer.vbo);
+		RenderState::bindArrayBuffer(buffer.vbo);
+		glBufferData(GL_ARRAY_BUFFER, buffer.recording.size(), buffer.recording.data(), GL_STATIC_DRAW);
+		setupVertexArray(buffer.vao, buffer.vbo);
+
+		// the GPU has its own copy now
+		std::vector<unsigned char>().swap(buffer.recording);
+	}
+	RenderState::bindVertexArray(0);
+	RenderState::bindArrayBuffer(0);
+}
+
+void Gizmos::applyStaticChanges() {
+	std::vector<StaticBatch> changes;
+	{
+		std::lock_guard<std::mutex> lock(m_staticMutex);
+		if (m_staticChanges.empty())
+			return;
+		changes.swap(m_staticChanges);
+	}
+
+	// in the order they were made, so recording a name after removing it keeps the recording
+	for (auto& change : changes)
+	{
+		StaticBatch* batch = findStatic(change.name.c_str());
+		if (batch != nullptr)
+		{
+			destroyStatic(*batch);
+			if (change.removed)
+			{
+				m_staticBatches.erase(m_staticBatches.begin() + (batch - m_staticBatches.data()));
+				continue;
+			}
+		}
+		else if (change.removed)
+			continue;
+		else
+		{
+			m_staticBatches.push_back(StaticBatch());
+			batch = &m_staticBatches.back();
+		}
+
+		std::swap(*batch, change);
+		uploadStatic(*batch);
+	}
+}
+
+void Gizmos::destroyStatic(StaticBatch& a_batch) {
+	for (auto& buffer : a_batch.buffers)
+	{
+		RenderState::deleteBuffer(buffer.vbo);
+		RenderState::deleteVertexArray(buffer.vao);
+		buffer.recording.clear();
+		buffer.count = 0;
+		buffer.vao = 0;
+		buffer.vbo = 0;
+	}
+}
+
+void Gizmos::drawStatic(Frame& a_frame, StreamType a_type, unsigned int a_mode) {
+	for (auto& batch : m_staticBatches)
+	{
+		const StaticBuffer& buffer = batch.buffers[a_type];
+		if (buffer.count == 0)
+			continue;
+
+		RenderState::bindVertexArray(buffer.vao);
+		glDrawArrays(a_mode, 0, buffer.count * a_frame.streams[a_type].vertices);
+		++a_frame.stats.drawCalls;
+	}
+}
+
+unsigned int Gizmos::staticCount(StreamType a_type) const {
+	unsigned int count = 0;
+	for (auto& batch : m_staticBatches)
+		count += batch.buffers[a_type].count;
+	return count;
+}
+
+void Gizmos::selectFrame() {
+	for (auto& stream : m_contexts[0]->frame.streams)
+	{
+		const size_t bytes = (size_t)stream.chunkSize * stream.vertices * m_vertexSize;
+		for (auto& chunk : stream.chunks)
+			chunk.data = (unsigned char*)chunk.storage + m_frame * bytes;
+	}
+}
+
+void Gizmos::writeVertex(unsigned char* a_dst, float a_x, float a_y, float a_z, const glm::vec4& a_colour) const {
+	if (m_format == VERTEX_PACKED)
+	{
+		PackedGizmoVertex* vertex = (PackedGizmoVertex*)a_dst;
+		vertex->x = a_x;
+		vertex->y = a_y;
+		vertex->z = a_z;
+		vertex->r = packChannel(a_colour.r);
+		vertex->g = packChannel(a_colour.g);
+		vertex->b = packChannel(a_colour.b);
+		vertex->a = packChannel(a_colour.a);
+	}
+	else
+	{
+		GizmoVertex* vertex = (GizmoVertex*)a_dst;
+		vertex->x = a_x;
+		vertex->y = a_y;
+		vertex->z = a_z;
+		vertex->w = 1;
+		vertex->r = a_colour.r;
+		vertex->g = a_colour.g;
+		vertex->b = a_colour.b;
+		vertex->a = a_colour.a;
+	}
+}
+
+void Gizmos::setupVertexArray(unsigned int& a_vao, unsigned int a_vbo) const {
+	glGenVertexArrays(1, &a_vao);
+	RenderState::bindVertexArray(a_vao);
+	RenderState::bindArrayBuffer(a_vbo);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	if (m_format == VERTEX_PACKED)
+	{
+		// the shader's Position.w defaults to 1 when only xyz is supplied
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedGizmoVertex), 0);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedGizmoVertex), ((char*)0) + 12);
+	}
+	else
+	{
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), ((char*)0) + 16);
+	}
+}
+
+// unit meshes, w is 0 for everything except a ring's outer edge
+static void buildSphere(unsigned int a_rows, unsigned int a_columns,
+						std::vector<glm::vec4>& a_lines, std::vector<glm::vec4>& a_tris) {
+	std::vector<glm::vec4> points((a_rows + 1) * a_columns);
+	for (unsigned int row = 0; row <= a_rows; ++row)
+	{
+		float latitude = float(row) / a_rows * glm::pi<float>() - glm::half_pi<float>();
+		float y = sinf(latitude);
+		float z = cosf(latitude);
+
+		for (unsigned int col = 0; col < a_columns; ++col)
+		{
+			float theta = float(col) / a_columns * 2 * glm::pi<float>();
+			points[row * a_columns + col] = glm::vec4(-z * sinf(theta), y, -z * cosf(theta), 0);
+		}
+	}
+
+	for (unsigned int face = 0; face < a_rows * a_columns; ++face)
+	{
+		unsigned int nextFace = face + 1;
+		if (nextFace % a_columns == 0)
+			nextFace -= a_columns;
+
+		a_lines.push_back(points[face]);
+		a_lines.push_back(points[face + a_columns]);
+		a_lines.push_back(points[nextFace + a_columns]);
+		a_lines.push_back(points[face + a_columns]);
+
+		a_tris.push_back(points[nextFace + a_columns]);
+		a_tris.push_back(points[face]);
+		a_tris.push_back(points[nextFace]);
+		a_tris.push_back(points[nextFace + a_columns]);
+		a_tris.push_back(points[face + a_columns]);
+		a_tris.push_back(points[face]);
+	}
+}
+
+static void buildCylinder(unsigned int a_segments, std::vector<glm::vec4>& a_lines, std::vector<glm::vec4>& a_tris) {
+	float segmentSize = (2 * glm::pi<float>()) / a_segments;
+	for (unsigned int i = 0; i < a_segments; ++i)
+	{
+		glm::vec4 v0top(0, 1, 0, 0);
+		glm::vec4 v1top(sinf(i * segmentSize), 1, cosf(i * segmentSize), 0);
+		glm::vec4 v2top(sinf((i + 1) * segmentSize), 1, cosf((i + 1) * segmentSize), 0);
+		glm::vec4 v0bottom(0, -1, 0, 0);
+		glm::vec4 v1bottom(v1top.x, -1, v1top.z, 0);
+		glm::vec4 v2bottom(v2top.x, -1, v2top.z, 0);
+
+		glm::vec4 tris[] = { v0top, v1top, v2top,  v0bottom, v2bottom, v1bottom,
+							 v2top, v1top, v1bottom,  v1bottom, v2bottom, v2top };
+		glm::vec4 lines[] = { v1top, v2top,  v1top, v1bottom,  v1bottom, v2bottom };
+		a_tris.insert(a_tris.end(), tris, tris + 12);
+		a_lines.insert(a_lines.end(), lines, lines + 6);
+	}
+}
+
+static void buildDisk(unsigned int a_segments, std::vector<glm::vec4>& a_lines, std::vector<glm::vec4>& a_tris) {
+	float segmentSize = (2 * glm::pi<float>()) / a_segments;
+	glm::vec4 center(0);
+	for (unsigned int i = 0; i < a_segments; ++i)
+	{
+		glm::vec4 v1outer(sinf(i * segmentSize), 0, cosf(i * segmentSize), 0);
+		glm::vec4 v2outer(sinf((i + 1) * segmentSize), 0, cosf((i + 1) * segmentSize), 0);
+
+		glm::vec4 tris[] = { center, v1outer, v2outer,  v2outer, v1outer, center };
+		a_tris.insert(a_tris.end(), tris, tris + 6);
+		a_lines.push_back(v1outer);
+		a_lines.push_back(v2outer);
+	}
+}
+
+static void buildRing(unsigned int a_segments, std::vector<glm::vec4>& a_lines, std::vector<glm::vec4>& a_tris) {
+	float segmentSize = (2 * glm::pi<float>()) / a_segments;
+	for (unsigned int i = 0; i < a_segments; ++i)
+	{
+		glm::vec4 v1inner(sinf(i * segmentSize), 0, cosf(i * segmentSize), 0);
+		glm::vec4 v2inner(sinf((i + 1) * segmentSize), 0, cosf((i + 1) * segmentSize), 0);
+		glm::vec4 v1outer(v1inner.x, 0, v1inner.z, 1);
+		glm::vec4 v2outer(v2inner.x, 0, v2inner.z, 1);
+
+		glm::vec4 tris[] = { v2outer, v1outer, v1inner,  v1inner, v2inner, v2outer,
+							 v1inner, v1outer, v2outer,  v2outer, v2inner, v1inner };
+		glm::vec4 lines[] = { v1inner, v2inner,  v1outer, v2outer };
+		a_tris.insert(a_tris.end(), tris, tris + 12);
+		a_lines.insert(a_lines.end(), lines, lines + 4);
+	}
+}
+
+Gizmos::ShapeMesh* Gizmos::shapeMesh(ShapeType a_type, unsigned int a_segments, unsigned int a_rows) {
+	// a static batch has to own its vertices
+	if (context().recording != nullptr || a_segments == 0 || (a_type == SHAPE_SPHERE && a_rows == 0))
+		return nullptr;
+
+	// meshes that already exist are found without locking
+	unsigned int count = m_shapeMeshCount;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		ShapeMesh& mesh = m_shapeMeshes[i];
+		if (mesh.type == a_type && mesh.segments == a_segments && mesh.rows == a_rows)
+			return &mesh;
+	}
+
+	// another thread may have built it while this one waited
+	std::lock_guard<std::mutex> lock(m_shapeMutex);
+	for (unsigned int i = count; i < m_shapeMeshCount; ++i)
+	{
+		ShapeMesh& mesh = m_shapeMeshes[i];
+		if (mesh.type == a_type && mesh.segments == a_segments && mesh.rows == a_rows)
+			return &mesh;
+	}
+	count = m_shapeMeshCount;
+	if (count == MAX_SHAPE_MESHES)
+		return nullptr;
+
+	std::vector<glm::vec4> vertices, tris;
+	switch (a_type)
+	{
+	case SHAPE_SPHERE:		buildSphere(a_rows, a_segments, vertices, tris);	break;
+	case SHAPE_CYLINDER:	buildCylinder(a_segments, vertices, tris);		break;
+	case SHAPE_DISK:		buildDisk(a_segments, vertices, tris);			break;
+	case SHAPE_RING:		buildRing(a_segments, vertices, tris);			break;
+	}
+
+	ShapeMesh& mesh = m_shapeMeshes[count];
+	mesh.type = a_type;
+	mesh.segments = a_segments;
+	mesh.rows = a_rows;
+	mesh.lineFirst = 0;
+	mesh.lineVertices = (unsigned int)vertices.size();
+	mesh.triFirst = mesh.lineVertices;
+	mesh.triVertices = (unsigned int)tris.size();
+	mesh.vao = 0;
+	mesh.vbo = 0;
+
+	// lines then triangles in one buffer
+	vertices.insert(vertices.end(), tris.begin(), tris.end());
+	mesh.unit.swap(vertices);
+
+	m_shapeMeshCount = count + 1;
+	return &mesh;
+}
+
+void Gizmos::createShapeBuffers(ShapeMesh& a_mesh) {
+	glGenBuffers(1, &a_mesh.vbo);
+	RenderState::bindArrayBuffer(a_mesh.vbo);
+	glBufferData(GL_ARRAY_BUFFER, a_mesh.unit.size() * sizeof(glm::vec4), a_mesh.unit.data(), GL_STATIC_DRAW);
+	std::vector<glm::vec4>().swap(a_mesh.unit);
+
+	glGenVertexArrays(1, &a_mesh.vao);
+	RenderState::bindVertexArray(a_mesh.vao);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), 0);
+
+	// instance attributes point into m_shapeVBO, at an offset that's only known on draw
+	for (unsigned int attribute = 1; attribute <= 5; ++attribute)
+	{
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribDivisor(attribute, 1);
+	}
+
+	RenderState::bindVertexArray(0);
+	RenderState::bindArrayBuffer(0);
+}
+
+void Gizmos::addShape(ShapeMesh& a_mesh, StreamType a_kind, const glm::vec3& a_center, const glm::vec3& a_scale,
+					  const glm::mat4* a_transform, float a_param0, float a_param1, const glm::vec4& a_colour) {
+	ShapeInstance instance;
+	for (int row = 0; row < 3; ++row)
+	{
+		// the transform only rotates, as it does for the tessellated shapes
+		for (int col = 0; col < 3; ++col)
+		{
+			float m = a_transform != nullptr ? (*a_transform)[col][row] : (row == col ? 1.0f : 0.0f);
+			instance.rows[row][col] = m * a_scale[col];
+		}
+		instance.rows[row][3] = a_center[row];
+	}
+	instance.params[0] = a_param0;
+	instance.params[1] = a_param1;
+	instance.colour[0] = packChannel(a_colour.r);
+	instance.colour[1] = packChannel(a_colour.g);
+	instance.colour[2] = packChannel(a_colour.b);
+	instance.colour[3] = packChannel(a_colour.a);
+
+	Frame& frame = context().frame;
+	size_t index = &a_mesh - m_shapeMeshes;
+	if (frame.shapes.size() <= index)
+		frame.shapes.resize(index + 1);
+	frame.shapes[index].kinds[a_kind].push_back(instance);
+	++frame.shapeCounts[a_kind];
+	frame.stats.primitives += a_kind == LINES ? a_mesh.lineVertices / 2 : a_mesh.triVertices / 3;
+}
+
+void Gizmos::uploadShapes(const std::vector<Frame*>& a_frames) {
+	// only the frames' first draw uploads, like the streams
+	if (a_frames[0]->streams[LINES].uploaded)
+		return;
+
+	// every thread's instances end to end
+	m_shapeUpload.clear();
+	for (Frame* frame : a_frames)
+	{
+		for (auto& instances : frame->shapes)
+		{
+			for (unsigned int kind = 0; kind < SHAPE_KINDS; ++kind)
+			{
+				instances.uploadFirst[kind] = (unsigned int)m_shapeUpload.size();
+				m_shapeUpload.insert(m_shapeUpload.end(), instances.kinds[kind].begin(), instances.kinds[kind].end());
+			}
+		}
+	}
+	if (m_shapeUpload.empty())
+		return;
+
+	size_t bytes = m_shapeUpload.size() * sizeof(ShapeInstance);
+	RenderState::bindArrayBuffer(m_shapeVBO);
+	glBufferData(GL_ARRAY_BUFFER, bytes, m_shapeUpload.data(), GL_STREAM_DRAW);
+	a_frames[0]->stats.bytesUploaded += bytes;
+}
+
+void Gizmos::drawShapes(Frame& a_frame, StreamType a_kind, unsigned int a_mode, const glm::mat4& a_projectionView) {
+	if (a_frame.shapeCounts[a_kind] == 0)
+		return;
+
+	RenderState::useProgram(m_shapeShader);
+	glUniformMatrix4fv(m_shapeProjectionViewUniform, 1, false, glm::value_ptr(a_projectionView));
+
+	for (size_t i = 0; i < a_frame.shapes.size(); ++i)
+	{
+		const ShapeInstances& instances = a_frame.shapes[i];
+		unsigned int count = (unsigned int)instances.kinds[a_kind].size();
+		if (count == 0)
+			continue;
+
+		// meshes are only ever appended, so the frame's indices hold while another thread adds more
+		ShapeMesh& mesh = m_shapeMeshes[i];
+		if (mesh.vao == 0)
+			createShapeBuffers(mesh);
+
+		// GL 3.3 has no base instance, so the instance attributes are re-pointed per mesh
+		const char* first = ((char*)0) + instances.uploadFirst[a_kind] * sizeof(ShapeInstance);
+		RenderState::bindVertexArray(mesh.vao);
+		RenderState::bindArrayBuffer(m_shapeVBO);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ShapeInstance), first);
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(ShapeInstance), first + 16);
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(ShapeInstance), first + 32);
+		glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(ShapeInstance), first + 48);
+		glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ShapeInstance), first + 56);
+
+		if (a_kind == LINES)
+			glDrawArraysInstanced(a_mode, mesh.lineFirst, mesh.lineVertices, count);
+		else
+			glDrawArraysInstanced(a_mode, mesh.triFirst, mesh.triVertices, count);
+		++a_frame.stats.drawCalls;
+	}
+}
+
 void Gizmos::clear() {
-	sm_singleton->m_lineCount = 0;
-	sm_singleton->m_triCount = 0;
-	sm_singleton->m_transparentTriCount = 0;
-	sm_singleton->m_2DlineCount = 0;
-	sm_singleton->m_2DtriCount = 0;
+	if (sm_singleton->m_persistent && sm_singleton->m_deferred == false)
+	{
+		// everything drawn from this frame's copy has been submitted, fence it and move on
+		// to the oldest copy, which only has to wait if the GPU is FRAME_COUNT frames behind
+		sm_singleton->m_fences[sm_singleton->m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		sm_singleton->m_frame = (sm_singleton->m_frame + 1) % FRAME_COUNT;
+
+		GLsync next = (GLsync)sm_singleton->m_fences[sm_singleton->m_frame];
+		if (next != nullptr)
+		{
+			while (glClientWaitSync(next, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				;
+			glDeleteSync(next);
+			sm_singleton->m_fences[sm_singleton->m_frame] = nullptr;
+		}
+		sm_singleton->selectFrame();
+	}
+
+	// immediate, the stats are taken before the frames are reset, deferred they're taken by acquire
+	if (sm_singleton->m_deferred == false)
+		sm_singleton->m_lastStats = sm_singleton->sumStats(sm_singleton->drawnFrames());
+
+	for (Context* context : sm_singleton->m_contexts)
+	{
+		// deferred, the frame is kept until it's published
+		if (sm_singleton->m_deferred == false || sm_singleton->m_cleared)
+			sm_singleton->resetFrame(context->frame);
+		context->frame.stats = Stats{ 0, 0, 0, 0, 0, 0, 0 };
+
+		context->lodPrevious.swap(context->lodLevels);
+		context->lodLevels.clear();
+	}
+	sm_singleton->m_cleared = true;
+
+	// every context is free to be taken again
+	++sm_singleton->m_epoch;
+}
+
+void Gizmos::publish() {
+	if (sm_singleton == nullptr || sm_singleton->m_deferred == false || sm_singleton->m_cleared == false)
+		return;
+
+	// the frames that come back are ones draw is finished with, or were never drawn at all
+	std::vector<Frame>& frames = sm_singleton->m_frames.writeBuffer();
+	for (size_t i = 0; i < sm_singleton->m_contexts.size(); ++i)
+	{
+		// a thread that started adding since these were last published
+		if (frames.size() == i)
+		{
+			frames.push_back(Frame());
+			sm_singleton->initFrame(frames.back(), false);
+		}
+
+		Frame& frame = sm_singleton->m_contexts[i]->frame;
+		std::swap(frame, frames[i]);
+		sm_singleton->resetFrame(frame);
+		frame.stats = Stats{ 0, 0, 0, 0, 0, 0, 0 };
+	}
+	sm_singleton->m_cleared = false;
+	sm_singleton->m_frames.publish();
+}
+
+void Gizmos::acquire() {
+	if (sm_singleton == nullptr || sm_singleton->m_deferred == false)
+		return;
+
+	// the stats are the last frames drawn's, with their uploads and draw calls, as they are when not deferred,
+	// and frames drawn again because nothing newer was published only count their last draw
+	std::vector<Frame*>& drawn = sm_singleton->drawnFrames();
+	Stats stats = sm_singleton->sumStats(drawn);
+
+	if (sm_singleton->m_persistent)
+	{
+		// the frames added to after the next publish were released by the last acquire, so were last
+		// drawn before it, and the fence it left must pass before they're written again
+		GLsync fence = (GLsync)sm_singleton->m_drawnFence;
+		if (fence != nullptr)
+		{
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				;
+			glDeleteSync(fence);
+		}
+		sm_singleton->m_drawnFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		// chunks added since the frames were last here were staged
+		for (Frame* frame : drawn)
+			sm_singleton->mapFrame(*frame);
+	}
+
+	if (sm_singleton->m_frames.acquire())
+		sm_singleton->m_lastStats = stats;
+	else
+	{
+		for (Frame* frame : drawn)
+		{
+			frame->stats.bytesUploaded = 0;
+			frame->stats.drawCalls = 0;
+		}
+	}
+}
+
+void Gizmos::initFrame(Frame& a_frame, bool a_persistent) {
+	initStream(a_frame.streams[LINES], LINES, 2, a_persistent);
+	initStream(a_frame.streams[TRIS], TRIS, 3, a_persistent);
+	initStream(a_frame.streams[TRANSPARENT_TRIS], TRANSPARENT_TRIS, 3, a_persistent);
+	initStream(a_frame.streams[LINES_2D], LINES_2D, 2, a_persistent);
+	initStream(a_frame.streams[TRIS_2D], TRIS_2D, 3, a_persistent);
+	for (auto& count : a_frame.shapeCounts)
+		count = 0;
+	a_frame.stats = Stats{ 0, 0, 0, 0, 0, 0, 0 };
+}
+
+void Gizmos::destroyFrame(Frame& a_frame) {
+	for (auto& stream : a_frame.streams)
+		destroyStream(stream);
+	a_frame.shapes.clear();
+}
+
+void Gizmos::resetFrame(Frame& a_frame) {
+	for (auto& stream : a_frame.streams)
+	{
+		for (auto& chunk : stream.chunks)
+			chunk.count = 0;
+		stream.count = 0;
+		stream.current = 0;
+		stream.uploaded = false;
+	}
+
+	for (auto& instances : a_frame.shapes)
+	{
+		for (auto& kind : instances.kinds)
+			kind.clear();
+	}
+	for (auto& count : a_frame.shapeCounts)
+		count = 0;
+}
+
+std::vector<Gizmos::Frame*>& Gizmos::drawnFrames() {
+	m_drawn.clear();
+	if (m_deferred == false)
+	{
+		for (Context* context : m_contexts)
+			m_drawn.push_back(&context->frame);
+		return m_drawn;
+	}
+
+	applyStaticChanges();
+	for (auto& frame : m_frames.readBuffer())
+		m_drawn.push_back(&frame);
+	return m_drawn;
 }
 
 // Adds 3 unit-length lines (red,green,blue) representing the 3 axis of a transform, 
 // at the transform's translation. Optional scale available.
 void Gizmos::addTransform(const glm::mat4& a_transform, float a_fScale /* = 1.0f */) {
+	if (sm_singleton != nullptr && sm_singleton->culled(a_transform[3].xyz(), a_fScale, &a_transform))
+		return;
+
 	glm::vec4 vXAxis = a_transform[3] + a_transform[0] * a_fScale;
 	glm::vec4 vYAxis = a_transform[3] + a_transform[1] * a_fScale;
 	glm::vec4 vZAxis = a_transform[3] + a_transform[2] * a_fScale;
@@ -191,6 +1240,9 @@ void Gizmos::addAABB(const glm::vec3& a_center,
 	const glm::vec3& a_rvExtents, 
 	const glm::vec4& a_colour, 
 	const glm::mat4* a_transform /* = nullptr */) {
+	if (sm_singleton != nullptr && sm_singleton->culled(a_center, glm::length(a_rvExtents), a_transform))
+		return;
+
 	glm::vec3 vVerts[8];
 	glm::vec3 vX(a_rvExtents.x, 0, 0);
 	glm::vec3 vY(0, a_rvExtents.y, 0);
@@ -235,6 +1287,9 @@ void Gizmos::addAABBFilled(const glm::vec3& a_center,
 	const glm::vec3& a_rvExtents, 
 	const glm::vec4& a_fillColour, 
 	const glm::mat4* a_transform /* = nullptr */) {
+	if (sm_singleton != nullptr && sm_singleton->culled(a_center, glm::length(a_rvExtents), a_transform))
+		return;
+
 	glm::vec3 vVerts[8];
 	glm::vec3 vX(a_rvExtents.x, 0, 0);
 	glm::vec3 vY(0, a_rvExtents.y, 0);
@@ -303,8 +1358,23 @@ void Gizmos::addAABBFilled(const glm::vec3& a_center,
 
 void Gizmos::addCylinderFilled(const glm::vec3& a_center, float a_radius, float a_fHalfLength,
 	unsigned int a_segments, const glm::vec4& a_fillColour, const glm::mat4* a_transform /* = nullptr */) {
+	if (sm_singleton != nullptr && sm_singleton->culled(a_center, sqrtf(a_radius * a_radius + a_fHalfLength * a_fHalfLength), a_transform))
+		return;
+
 	glm::vec4 white(1,1,1,1);
 
+	if (sm_singleton != nullptr)
+		a_segments >>= sm_singleton->lodLevel(a_center, 2 * glm::pi<float>() * a_radius, a_transform, a_segments, 6);
+
+	ShapeMesh* mesh = sm_singleton != nullptr ? sm_singleton->shapeMesh(SHAPE_CYLINDER, a_segments, 0) : nullptr;
+	if (mesh != nullptr)
+	{
+		glm::vec3 scale(a_radius, a_fHalfLength, a_radius);
+		sm_singleton->addShape(*mesh, a_fillColour.w == 1 ? TRIS : TRANSPARENT_TRIS, a_center, scale, a_transform, 1, 1, a_fillColour);
+		sm_singleton->addShape(*mesh, LINES, a_center, scale, a_transform, 1, 1, white);
+		return;
+	}
+
 	float segmentSize = (2 * glm::pi<float>()) / a_segments;
 
 	for ( unsigned int i = 0 ; i < a_segments ; ++i )
@@ -341,9 +1411,25 @@ void Gizmos::addCylinderFilled(const glm::vec3& a_center, float a_radius, float
 
 void Gizmos::addRing(const glm::vec3& a_center, float a_innerRadius, float a_outerRadius,
 	unsigned int a_segments, const glm::vec4& a_fillColour, const glm::mat4* a_transform /* = nullptr */) {
+	if (sm_singleton != nullptr && sm_singleton->culled(a_center, a_outerRadius, a_transform))
+		return;
+
 	glm::vec4 vSolid = a_fillColour;
 	vSolid.w = 1;
 
+	if (sm_singleton != nullptr)
+		a_segments >>= sm_singleton->lodLevel(a_center, 2 * glm::pi<float>() * a_outerRadius, a_transform, a_segments, 6);
+
+	ShapeMesh* mesh = sm_singleton != nullptr ? sm_singleton->shapeMesh(SHAPE_RING, a_segments, 0) : nullptr;
+	if (mesh != nullptr)
+	{
+		if (a_fillColour.w != 0)
+			sm_singleton->addShape(*mesh, a_fillColour.w == 1 ? TRIS : TRANSPARENT_TRIS, a_center, glm::vec3(1), a_transform, a_innerRadius, a_outerRadius, a_fillColour);
+		else
+			sm_singleton->addShape(*mesh, LINES, a_center, glm::vec3(1), a_transform, a_innerRadius, a_outerRadius, vSolid);
+		return;
+	}
+
 	float fSegmentSize = (2 * glm::pi<float>()) / a_segments;
 
 	for ( unsigned int i = 0 ; i < a_segments ; ++i )
@@ -372,17 +1458,33 @@ void Gizmos::addRing(const glm::vec3& a_center, float a_innerRadius, float a_out
 		else
 		{
 			// line
-			addLine(a_center + v1inner + a_center, a_center + v2inner + a_center, vSolid, vSolid);
-			addLine(a_center + v1outer + a_center, a_center + v2outer + a_center, vSolid, vSolid);
+			addLine(a_center + v1inner, a_center + v2inner, vSolid, vSolid);
+			addLine(a_center + v1outer, a_center + v2outer, vSolid, vSolid);
 		}
 	}
 }
 
 void Gizmos::addDisk(const glm::vec3& a_center, float a_radius,
 	unsigned int a_segments, const glm::vec4& a_fillColour, const glm::mat4* a_transform /* = nullptr */) {
+	if (sm_singleton != nullptr && sm_singleton->culled(a_center, a_radius, a_transform))
+		return;
+
 	glm::vec4 vSolid = a_fillColour;
 	vSolid.w = 1;
 
+	if (sm_singleton != nullptr)
+		a_segments >>= sm_singleton->lodLevel(a_center, 2 * glm::pi<float>() * a_radius, a_transform, a_segments, 6);
+
+	ShapeMesh* mesh = sm_singleton != nullptr ? sm_singleton->shapeMesh(SHAPE_DISK, a_segments, 0) : nullptr;
+	if (mesh != nullptr)
+	{
+		if (a_fillColour.w != 0)
+			sm_singleton->addShape(*mesh, a_fillColour.w == 1 ? TRIS : TRANSPARENT_TRIS, a_center, glm::vec3(1), a_transform, a_radius, a_radius, a_fillColour);
+		else
+			sm_singleton->addShape(*mesh, LINES, a_center, glm::vec3(1), a_transform, a_radius, a_radius, vSolid);
+		return;
+	}
+
 	float fSegmentSize = (2 * glm::pi<float>()) / a_segments;
 
 	for ( unsigned int i = 0 ; i < a_segments ; ++i )
@@ -412,9 +1514,15 @@ void Gizmos::addDisk(const glm::vec3& a_center, float a_radius,
 void Gizmos::addArc(const glm::vec3& a_center, float a_rotation,
 	float a_radius, float a_arcHalfAngle,
 	unsigned int a_segments, const glm::vec4& a_fillColour, const glm::mat4* a_transform /* = nullptr */) {
+	if (sm_singleton != nullptr && sm_singleton->culled(a_center, a_radius, a_transform))
+		return;
+
 	glm::vec4 vSolid = a_fillColour;
 	vSolid.w = 1;
 
+	if (sm_singleton != nullptr)
+		a_segments >>= sm_singleton->lodLevel(a_center, 2 * a_arcHalfAngle * a_radius, a_transform, a_segments, 2);
+
 	float fSegmentSize = (2 * a_arcHalfAngle) / a_segments;
 
 	for ( unsigned int i = 0 ; i < a_segments ; ++i )
@@ -460,9 +1568,15 @@ void Gizmos::addArc(const glm::vec3& a_center, float a_rotation,
 void Gizmos::addArcRing(const glm::vec3& a_center, float a_rotation, 
 	float a_innerRadius, float a_outerRadius, float a_arcHalfAngle,
 	unsigned int a_segments, const glm::vec4& a_fillColour, const glm::mat4* a_transform /* = nullptr */) {
+	if (sm_singleton != nullptr && sm_singleton->culled(a_center, a_outerRadius, a_transform))
+		return;
+
 	glm::vec4 vSolid = a_fillColour;
 	vSolid.w = 1;
 
+	if (sm_singleton != nullptr)
+		a_segments >>= sm_singleton->lodLevel(a_center, 2 * a_arcHalfAngle * a_outerRadius, a_transform, a_segments, 2);
+
 	float fSegmentSize = (2 * a_arcHalfAngle) / a_segments;
 
 	for ( unsigned int i = 0 ; i < a_segments ; ++i )
@@ -520,6 +1634,28 @@ void Gizmos::addArcRing(const glm::vec3& a_center, float a_rotation,
 void Gizmos::addSphere(const glm::vec3& a_center, float a_radius, int a_rows, int a_columns, const glm::vec4& a_fillColour, 
 								const glm::mat4* a_transform /*= nullptr*/, float a_longMin /*= 0.f*/, float a_longMax /*= 360*/, 
 								float a_latMin /*= -90*/, float a_latMax /*= 90*/) {
+	if (sm_singleton != nullptr && sm_singleton->culled(a_center, a_radius, a_transform))
+		return;
+
+	// rows follow the columns down, a sphere's silhouette is the same size whichever way it's seen
+	if (sm_singleton != nullptr && a_columns > 0)
+	{
+		unsigned int level = sm_singleton->lodLevel(a_center, glm::radians(a_longMax - a_longMin) * a_radius, a_transform, a_columns, 6);
+		a_columns >>= level;
+		if (level > 0)
+			a_rows = glm::max(a_rows >> level, glm::min(a_rows, 2));
+	}
+
+	// only whole spheres are cached
+	bool whole = a_longMin == 0 && a_longMax == 360 && a_latMin == -90 && a_latMax == 90;
+	ShapeMesh* mesh = sm_singleton != nullptr && whole && a_rows > 0 && a_columns > 0 ? sm_singleton->shapeMesh(SHAPE_SPHERE, a_columns, a_rows) : nullptr;
+	if (mesh != nullptr)
+	{
+		sm_singleton->addShape(*mesh, a_fillColour.w == 1 ? TRIS : TRANSPARENT_TRIS, a_center, glm::vec3(1), a_transform, a_radius, a_radius, a_fillColour);
+		sm_singleton->addShape(*mesh, LINES, a_center, glm::vec3(1), a_transform, a_radius, a_radius, glm::vec4(1));
+		return;
+	}
+
 	float inverseRadius = 1/a_radius;
 	//Invert these first as the multiply is slightly quicker
 	float invColumns = 1.0f/float(a_columns);
@@ -587,6 +1723,13 @@ void Gizmos::addHermiteSpline(const glm::vec3& a_start, const glm::vec3& a_end,
 	const glm::vec3& a_tangentStart, const glm::vec3& a_tangentEnd, unsigned int a_segments, const glm::vec4& a_colour) {
 	a_segments = a_segments > 1 ? a_segments : 1;
 
+	// the curve is no longer than its control polygon, so that bounds the length on screen
+	if (sm_singleton != nullptr)
+	{
+		float length = glm::distance(a_start, a_end) + (glm::length(a_tangentStart) + glm::length(a_tangentEnd)) / 3;
+		a_segments >>= sm_singleton->lodLevel((a_start + a_end) * 0.5f, length, nullptr, a_segments, 2);
+	}
+
 	glm::vec3 prev = a_start;
 
 	for ( unsigned int i = 1 ; i <= a_segments ; ++i )
@@ -611,100 +1754,75 @@ void Gizmos::addLine(const glm::vec3& a_rv0,  const glm::vec3& a_rv1, const glm:
 }
 
 void Gizmos::addLine(const glm::vec3& a_rv0, const glm::vec3& a_rv1, const glm::vec4& a_colour0, const glm::vec4& a_colour1) {
-	if (sm_singleton != nullptr &&
-		sm_singleton->m_lineCount < sm_singleton->m_maxLines)
+	if (sm_singleton != nullptr)
 	{
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.x = a_rv0.x;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.y = a_rv0.y;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.z = a_rv0.z;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.w = 1;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.r = a_colour0.r;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.g = a_colour0.g;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.b = a_colour0.b;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v0.a = a_colour0.a;
-
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.x = a_rv1.x;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.y = a_rv1.y;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.z = a_rv1.z;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.w = 1;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.r = a_colour1.r;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.g = a_colour1.g;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.b = a_colour1.b;
-		sm_singleton->m_lines[sm_singleton->m_lineCount].v1.a = a_colour1.a;
-
-		sm_singleton->m_lineCount++;
+		unsigned char* line = sm_singleton->allocate(LINES);
+		if (line != nullptr)
+		{
+			sm_singleton->writeVertex(line, a_rv0.x, a_rv0.y, a_rv0.z, a_colour0);
+			sm_singleton->writeVertex(line + sm_singleton->m_vertexSize, a_rv1.x, a_rv1.y, a_rv1.z, a_colour1);
+		}
 	}
 }
 
 void Gizmos::addTri(const glm::vec3& a_rv0, const glm::vec3& a_rv1, const glm::vec3& a_rv2, const glm::vec4& a_colour) {
 	if (sm_singleton != nullptr)
 	{
-		if (a_colour.w == 1)
+		unsigned char* tri = sm_singleton->allocate(a_colour.w == 1 ? TRIS : TRANSPARENT_TRIS);
+		if (tri != nullptr)
 		{
-			if (sm_singleton->m_triCount < sm_singleton->m_maxTris)
-			{
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.x = a_rv0.x;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.y = a_rv0.y;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.z = a_rv0.z;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.w = 1;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.x = a_rv1.x;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.y = a_rv1.y;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.z = a_rv1.z;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.w = 1;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.x = a_rv2.x;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.y = a_rv2.y;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.z = a_rv2.z;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.w = 1;
-
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.r = a_colour.r;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.g = a_colour.g;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.b = a_colour.b;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v0.a = a_colour.a;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.r = a_colour.r;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.g = a_colour.g;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.b = a_colour.b;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v1.a = a_colour.a;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.r = a_colour.r;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.g = a_colour.g;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.b = a_colour.b;
-				sm_singleton->m_tris[sm_singleton->m_triCount].v2.a = a_colour.a;
-
-				sm_singleton->m_triCount++;
-			}
+			unsigned int vertexSize = sm_singleton->m_vertexSize;
+			sm_singleton->writeVertex(tri, a_rv0.x, a_rv0.y, a_rv0.z, a_colour);
+			sm_singleton->writeVertex(tri + vertexSize, a_rv1.x, a_rv1.y, a_rv1.z, a_colour);
+			sm_singleton->writeVertex(tri + vertexSize * 2, a_rv2.x, a_rv2.y, a_rv2.z, a_colour);
 		}
-		else
+	}
+}
+
+void Gizmos::addLines(const LineDesc* a_lines, size_t a_count) {
+	if (sm_singleton == nullptr)
+		return;
+
+	while (a_count > 0)
+	{
+		size_t granted;
+		unsigned char* dst = sm_singleton->reserve(LINES, a_count, granted);
+		if (dst == nullptr)
+			return;
+
+		sm_singleton->writeLines(dst, a_lines, granted);
+		a_lines += granted;
+		a_count -= granted;
+	}
+}
+
+void Gizmos::addTris(const TriDesc* a_tris, size_t a_count) {
+	if (sm_singleton == nullptr)
+		return;
+
+	while (a_count > 0)
+	{
+		// opaque and transparent go to different streams, so take each run of one or the other together
+		bool opaque = a_tris[0].colour.w == 1;
+		size_t run = 1;
+		while (run < a_count && (a_tris[run].colour.w == 1) == opaque)
+			++run;
+
+		StreamType type = opaque ? TRIS : TRANSPARENT_TRIS;
+		size_t remaining = run;
+		while (remaining > 0)
 		{
-			if (sm_singleton->m_transparentTriCount < sm_singleton->m_maxTris)
-			{
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.x = a_rv0.x;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.y = a_rv0.y;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.z = a_rv0.z;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.w = 1;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.x = a_rv1.x;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.y = a_rv1.y;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.z = a_rv1.z;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.w = 1;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.x = a_rv2.x;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.y = a_rv2.y;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.z = a_rv2.z;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.w = 1;
-
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.r = a_colour.r;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.g = a_colour.g;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.b = a_colour.b;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v0.a = a_colour.a;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.r = a_colour.r;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.g = a_colour.g;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.b = a_colour.b;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v1.a = a_colour.a;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.r = a_colour.r;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.g = a_colour.g;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.b = a_colour.b;
-				sm_singleton->m_transparentTris[sm_singleton->m_transparentTriCount].v2.a = a_colour.a;
-
-				sm_singleton->m_transparentTriCount++;
-			}
+			size_t granted;
+			unsigned char* dst = sm_singleton->reserve(type, remaining, granted);
+			if (dst == nullptr)
+				break;
+
+			sm_singleton->writeTris(dst, a_tris + (run - remaining), granted);
+			remaining -= granted;
 		}
+
+		a_tris += run;
+		a_count -= run;
 	}
 }
 
@@ -785,61 +1903,27 @@ void Gizmos::add2DLine(const glm::vec2& a_rv0,  const glm::vec2& a_rv1, const gl
 }
 
 void Gizmos::add2DLine(const glm::vec2& a_rv0, const glm::vec2& a_rv1, const glm::vec4& a_colour0, const glm::vec4& a_colour1) {
-	if (sm_singleton != nullptr &&
-		sm_singleton->m_2DlineCount < sm_singleton->m_max2DLines)
-	{
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.x = a_rv0.x;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.y = a_rv0.y;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.z = 1;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.w = 1;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.r = a_colour0.r;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.g = a_colour0.g;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.b = a_colour0.b;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v0.a = a_colour0.a;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.x = a_rv1.x;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.y = a_rv1.y;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.z = 1;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.w = 1;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.r = a_colour1.r;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.g = a_colour1.g;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.b = a_colour1.b;
-		sm_singleton->m_2Dlines[sm_singleton->m_2DlineCount].v1.a = a_colour1.a;
-
-		sm_singleton->m_2DlineCount++;
+	if (sm_singleton != nullptr)
+	{
+		unsigned char* line = sm_singleton->allocate(LINES_2D);
+		if (line != nullptr)
+		{
+			sm_singleton->writeVertex(line, a_rv0.x, a_rv0.y, 1, a_colour0);
+			sm_singleton->writeVertex(line + sm_singleton->m_vertexSize, a_rv1.x, a_rv1.y, 1, a_colour1);
+		}
 	}
 }
 
 void Gizmos::add2DTri(const glm::vec2& a_rv0, const glm::vec2& a_rv1, const glm::vec2& a_rv2, const glm::vec4& a_colour) {
 	if (sm_singleton != nullptr)
 	{
-		if (sm_singleton->m_2DtriCount < sm_singleton->m_max2DTris)
-		{
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.x = a_rv0.x;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.y = a_rv0.y;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.z = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.w = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.x = a_rv1.x;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.y = a_rv1.y;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.z = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.w = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.x = a_rv2.x;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.y = a_rv2.y;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.z = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.w = 1;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.r = a_colour.r;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.g = a_colour.g;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.b = a_colour.b;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v0.a = a_colour.a;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.r = a_colour.r;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.g = a_colour.g;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.b = a_colour.b;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v1.a = a_colour.a;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.r = a_colour.r;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.g = a_colour.g;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.b = a_colour.b;
-			sm_singleton->m_2Dtris[sm_singleton->m_2DtriCount].v2.a = a_colour.a;
-
-			sm_singleton->m_2DtriCount++;
+		unsigned char* tri = sm_singleton->allocate(TRIS_2D);
+		if (tri != nullptr)
+		{
+			unsigned int vertexSize = sm_singleton->m_vertexSize;
+			sm_singleton->writeVertex(tri, a_rv0.x, a_rv0.y, 1, a_colour);
+			sm_singleton->writeVertex(tri + vertexSize, a_rv1.x, a_rv1.y, 1, a_colour);
+			sm_singleton->writeVertex(tri + vertexSize * 2, a_rv2.x, a_rv2.y, 1, a_colour);
 		}
 	}
 }
@@ -849,119 +1933,110 @@ void Gizmos::draw(const glm::mat4& a_projection, const glm::mat4& a_view) {
 }
 
 void Gizmos::draw(const glm::mat4& a_projectionView) {
-	if ( sm_singleton != nullptr && (sm_singleton->m_lineCount > 0 || sm_singleton->m_triCount > 0 || sm_singleton->m_transparentTriCount > 0))
+	if (sm_singleton == nullptr)
+		return;
+	PROFILE_SCOPE("Gizmos::draw");
+
+	// every thread's frame, drawn one after another
+	std::vector<Frame*>& frames = sm_singleton->drawnFrames();
+	bool opaque = sm_singleton->m_staticBatches.empty() == false;
+	bool transparent = sm_singleton->staticCount(TRANSPARENT_TRIS) > 0;
+	for (Frame* frame : frames)
 	{
-		int shader = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &shader);
+		opaque = opaque || frame->streams[LINES].count > 0 || frame->streams[TRIS].count > 0 ||
+				 frame->shapeCounts[LINES] > 0 || frame->shapeCounts[TRIS] > 0;
+		transparent = transparent || frame->streams[TRANSPARENT_TRIS].count > 0 || frame->shapeCounts[TRANSPARENT_TRIS] > 0;
+	}
 
-		glUseProgram(sm_singleton->m_shader);
-		
-		unsigned int projectionViewUniform = glGetUniformLocation(sm_singleton->m_shader,"ProjectionView");
-		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(a_projectionView));
+	if (opaque || transparent)
+	{
+		sm_singleton->uploadShapes(frames);
 
-		if (sm_singleton->m_lineCount > 0)
-		{
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_lineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_lineCount * sizeof(GizmoLine), sm_singleton->m_lines);
+		RenderState::useProgram(sm_singleton->m_shader);
+		glUniformMatrix4fv(sm_singleton->m_projectionViewUniform, 1, false, glm::value_ptr(a_projectionView));
 
-			glBindVertexArray(sm_singleton->m_lineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_lineCount * 2);
+		sm_singleton->drawStatic(*frames[0], LINES, GL_LINES);
+		sm_singleton->drawStatic(*frames[0], TRIS, GL_TRIANGLES);
+		for (Frame* frame : frames)
+		{
+			sm_singleton->drawStream(*frame, LINES, GL_LINES);
+			sm_singleton->drawStream(*frame, TRIS, GL_TRIANGLES);
 		}
-
-		if (sm_singleton->m_triCount > 0)
+		for (Frame* frame : frames)
 		{
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_triVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_triCount * sizeof(GizmoTri), sm_singleton->m_tris);
-
-			glBindVertexArray(sm_singleton->m_triVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_triCount * 3);
+			sm_singleton->drawShapes(*frame, LINES, GL_LINES, a_projectionView);
+			sm_singleton->drawShapes(*frame, TRIS, GL_TRIANGLES, a_projectionView);
 		}
 
-		if (sm_singleton->m_transparentTriCount > 0)
+		if (transparent)
 		{
-			// not ideal to store these, but Gizmos must work stand-alone
-			GLboolean blendEnabled = glIsEnabled(GL_BLEND);
-			GLboolean depthMask = GL_TRUE;
-			glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
-			int src, dst;
-			glGetIntegerv(GL_BLEND_SRC, &src);
-			glGetIntegerv(GL_BLEND_DST, &dst);
+			// the shadowed state, so restoring it costs no queries
+			bool blendEnabled = RenderState::isEnabled(RenderState::BLEND);
+			bool depthMask = RenderState::getDepthMask();
+			unsigned int src, dst;
+			RenderState::getBlendFunc(src, dst);
 
 			// setup blend states
-			if (blendEnabled == GL_FALSE)
-				glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glDepthMask(GL_FALSE);
+			RenderState::setEnabled(RenderState::BLEND, true);
+			RenderState::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			RenderState::setDepthMask(false);
 
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_transparentTriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_transparentTriCount * sizeof(GizmoTri), sm_singleton->m_transparentTris);
-
-			glBindVertexArray(sm_singleton->m_transparentTriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_transparentTriCount * 3);
+			RenderState::useProgram(sm_singleton->m_shader);
+			sm_singleton->drawStatic(*frames[0], TRANSPARENT_TRIS, GL_TRIANGLES);
+			for (Frame* frame : frames)
+				sm_singleton->drawStream(*frame, TRANSPARENT_TRIS, GL_TRIANGLES);
+			for (Frame* frame : frames)
+				sm_singleton->drawShapes(*frame, TRANSPARENT_TRIS, GL_TRIANGLES, a_projectionView);
 
 			// reset state
-			glDepthMask(depthMask);
-			glBlendFunc(src, dst);
-			if (blendEnabled == GL_FALSE)
-				glDisable(GL_BLEND);
+			RenderState::setDepthMask(depthMask);
+			RenderState::setBlendFunc(src, dst);
+			RenderState::setEnabled(RenderState::BLEND, blendEnabled);
 		}
-
-		glUseProgram(shader);
 	}
 }
 
 void Gizmos::draw2D(const glm::mat4& a_projection) {
-	if ( sm_singleton != nullptr && (sm_singleton->m_2DlineCount > 0 || sm_singleton->m_2DtriCount > 0))
-	{
-		int shader = 0;
-		glGetIntegerv(GL_CURRENT_PROGRAM, &shader);
+	if (sm_singleton == nullptr)
+		return;
+	PROFILE_SCOPE("Gizmos::draw2D");
 
-		glUseProgram(sm_singleton->m_shader);
-		
-		unsigned int projectionViewUniform = glGetUniformLocation(sm_singleton->m_shader,"ProjectionView");
-		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(a_projection));
+	std::vector<Frame*>& frames = sm_singleton->drawnFrames();
+	bool lines = sm_singleton->m_staticBatches.empty() == false;
+	bool tris = sm_singleton->staticCount(TRIS_2D) > 0;
+	for (Frame* frame : frames)
+	{
+		lines = lines || frame->streams[LINES_2D].count > 0;
+		tris = tris || frame->streams[TRIS_2D].count > 0;
+	}
 
-		if (sm_singleton->m_2DlineCount > 0)
-		{
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DlineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DlineCount * sizeof(GizmoLine), sm_singleton->m_2Dlines);
+	if (lines || tris)
+	{
+		RenderState::useProgram(sm_singleton->m_shader);
+		glUniformMatrix4fv(sm_singleton->m_projectionViewUniform, 1, false, glm::value_ptr(a_projection));
 
-			glBindVertexArray(sm_singleton->m_2DlineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_2DlineCount * 2);
-		}
+		sm_singleton->drawStatic(*frames[0], LINES_2D, GL_LINES);
+		for (Frame* frame : frames)
+			sm_singleton->drawStream(*frame, LINES_2D, GL_LINES);
 
-		if (sm_singleton->m_2DtriCount > 0)
+		if (tris)
 		{
-			GLboolean blendEnabled = glIsEnabled(GL_BLEND);
-
-			GLboolean depthMask = GL_TRUE;
-			glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
-
-			int src, dst;
-			glGetIntegerv(GL_BLEND_SRC, &src);
-			glGetIntegerv(GL_BLEND_DST, &dst);
-
-			if (blendEnabled == GL_FALSE)
-				glEnable(GL_BLEND);
-
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-			glDepthMask(GL_FALSE);
-
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DtriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DtriCount * sizeof(GizmoTri), sm_singleton->m_2Dtris);
-
-			glBindVertexArray(sm_singleton->m_2DtriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_2DtriCount * 3);
-
-			glDepthMask(depthMask);
-
-			glBlendFunc(src, dst);
-
-			if (blendEnabled == GL_FALSE)
-				glDisable(GL_BLEND);
+			bool blendEnabled = RenderState::isEnabled(RenderState::BLEND);
+			bool depthMask = RenderState::getDepthMask();
+			unsigned int src, dst;
+			RenderState::getBlendFunc(src, dst);
+
+			RenderState::setEnabled(RenderState::BLEND, true);
+			RenderState::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			RenderState::setDepthMask(false);
+
+			sm_singleton->drawStatic(*frames[0], TRIS_2D, GL_TRIANGLES);
+			for (Frame* frame : frames)
+				sm_singleton->drawStream(*frame, TRIS_2D, GL_TRIANGLES);
+
+			RenderState::setDepthMask(depthMask);
+			RenderState::setBlendFunc(src, dst);
+			RenderState::setEnabled(RenderState::BLEND, blendEnabled);
 		}
-
-		glUseProgram(shader);
 	}
-}
\ No newline at end of file
+}
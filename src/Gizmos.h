@@ -1,17 +1,78 @@
 #pragma once
 
 #include <glm/fwd.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include "TripleBuffer.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Camera;
 
 class Gizmos {
 public:
 
+	// VERTEX_FLOAT is 32 bytes per vertex, VERTEX_PACKED drops w and normalises the colour into
+	// bytes for 16 bytes per vertex, half the memory written and uploaded for every gizmo
+	enum VertexFormat {
+		VERTEX_FLOAT,
+		VERTEX_PACKED,
+	};
+
+	// the max counts are per chunk, each type grows a chunk at a time up to MAX_CHUNKS
+	// deferred Gizmos never touch GL while adding, for drawing on a thread of its own, see publish
+	// any thread can add, each records into its own chunks without locking and draw concatenates
+	// them, but nothing may be adding while clear, publish, draw or the static batch functions run
 	static void		create(unsigned int a_maxLines = 0xffff, unsigned int a_maxTris = 0xffff,
-						   unsigned int a_max2DLines = 0xff, unsigned int a_max2DTris = 0xff);
+						   unsigned int a_max2DLines = 0xff, unsigned int a_max2DTris = 0xff,
+						   VertexFormat a_format = VERTEX_FLOAT, bool a_deferred = false);
 	static void		destroy();
 
-	// removes all Gizmos
+	// removes all Gizmos, and ends the frame counted by getStats
 	static void		clear();
 
+	// deferred only, hands everything added since the last clear on to acquire, publishing again
+	// without a clear in between does nothing
+	static void		publish();
+
+	// deferred only, on the drawing thread, takes the newest published frame for draw and draw2D,
+	// which keep drawing the last one taken until acquire finds a newer one
+	// with GL 4.4 it also maps the frames, which are only safe to add to again once the GPU is done
+	// with them if publish runs at most once between two acquires, as a render thread handshake ensures
+	static void		acquire();
+
+	struct Stats {
+		unsigned int	primitives;		// lines and triangles added, 3D and 2D
+		unsigned int	dropped;		// added after every chunk of their type was full
+		size_t			bytesUploaded;	// vertex data drawn, copied or written to mapped memory
+		unsigned int	drawCalls;
+		unsigned int	chunks;			// allocated so far, across every type
+		unsigned int	culled;			// shapes skipped for being outside the camera's frustum
+		unsigned int	reduced;		// shapes tessellated with fewer segments than asked for
+	};
+
+	// counts for the frame before the last clear, or when deferred the last frame drawn,
+	// which is only safe to read on the drawing thread
+	static const Stats&	getStats();
+
+	// shapes whose bounds are outside its frustum are skipped before being tessellated or instanced,
+	// lines and triangles added directly are never culled, nullptr turns culling off
+	static void		setCamera(const Camera* a_camera);
+
+	// with a camera set, tessellated shapes and splines drop to a half, a quarter and so on of their
+	// segments as they shrink on screen, aiming for segments around a_segmentPixels long in a viewport
+	// a_viewportHeight pixels tall, a_segmentPixels of 0 turns it off, static batches are never reduced
+	static void		setLevelOfDetail(float a_viewportHeight, float a_segmentPixels = 8);
+
+	// everything added between these is uploaded once to its own buffers at endStatic and then
+	// drawn by every draw/draw2D until removed, recording a name again replaces that batch
+	// only what the recording thread adds goes in it, and only one thread may record at a time
+	static void		beginStatic(const char* a_name);
+	static void		endStatic();
+	static void		removeStatic(const char* a_name);
+
 	// draws current Gizmo buffers, either using a combined (projection * view) matrix, or separate matrices
 	static void		draw(const glm::mat4& a_projectionView);
 	static void		draw(const glm::mat4& a_projection, const glm::mat4& a_view);
@@ -30,6 +91,23 @@ public:
 	// Adds a triangle.
 	static void		addTri(const glm::vec3& a_rv0, const glm::vec3& a_rv1, const glm::vec3& a_rv2, const glm::vec4& a_colour);
 
+	struct LineDesc {
+		glm::vec3	start;
+		glm::vec3	end;
+		glm::vec4	colour;
+	};
+
+	struct TriDesc {
+		glm::vec3	v0;
+		glm::vec3	v1;
+		glm::vec3	v2;
+		glm::vec4	colour;
+	};
+
+	// Adds a whole array of lines or triangles, reserving space once per chunk rather than once per primitive
+	static void		addLines(const LineDesc* a_lines, size_t a_count);
+	static void		addTris(const TriDesc* a_tris, size_t a_count);
+
 	// Adds 3 unit-length lines (red,green,blue) representing the 3 axis of a transform, 
 	// at the transform's translation. Optional scale available.
 	static void		addTransform(const glm::mat4& a_transform, float a_fScale = 1.0f);
@@ -42,6 +120,10 @@ public:
 	static void		addAABBFilled(const glm::vec3& a_center, const glm::vec3& a_extents, 
 								  const glm::vec4& a_fillColour, const glm::mat4* a_transform = nullptr);
 
+	// cylinders, rings, disks and full spheres are instances of a unit mesh cached per shape and
+	// tessellation, so each one only costs its transform and colour, partial spheres and
+	// anything added between beginStatic and endStatic are still tessellated into triangles
+
 	// Adds a cylinder aligned to the Y-axis with optional transform for rotation.
 	static void		addCylinderFilled(const glm::vec3& a_center, float a_radius, float a_fHalfLength,
 									  unsigned int a_segments, const glm::vec4& a_fillColour, const glm::mat4* a_transform = nullptr);
@@ -88,7 +170,8 @@ public:
 private:
 
 	Gizmos(unsigned int a_maxLines, unsigned int a_maxTris,
-		   unsigned int a_max2DLines, unsigned int a_max2DTris);
+		   unsigned int a_max2DLines, unsigned int a_max2DTris,
+		   VertexFormat a_format, bool a_deferred);
 	~Gizmos();
 
 	struct GizmoVertex {
@@ -96,56 +179,252 @@ private:
 		float r, g, b, a;
 	};
 
-	struct GizmoLine {
-		GizmoVertex v0;
-		GizmoVertex v1;
+	struct PackedGizmoVertex {
+		float x, y, z;
+		unsigned char r, g, b, a;
+	};
+
+	// writes a vertex at a_dst in whichever format was chosen at create
+	void			writeVertex(unsigned char* a_dst, float a_x, float a_y, float a_z, const glm::vec4& a_colour) const;
+
+	// creates a VAO reading a_vbo in the chosen format
+	void			setupVertexArray(unsigned int& a_vao, unsigned int a_vbo) const;
+
+	// with GL 4.4 every VBO holds FRAME_COUNT copies of its data, persistently mapped, and the
+	// add functions write straight into the copy the GPU finished with FRAME_COUNT frames ago
+	// deferred frames already take turns, so each of their VBOs is a single mapped copy instead
+	// without it the arrays are CPU staging memory, uploaded with glBufferSubData on draw
+	static const unsigned int FRAME_COUNT = 3;
+
+	// limits how far a single type can grow, anything past it is dropped and counted
+	static const unsigned int MAX_CHUNKS = 16;
+
+	// a fixed number of primitives with its own VBO and VAO, so adding a chunk never moves
+	// or re-uploads the ones before it, and each is drawn with its own call
+	// staged chunks only get their VBO and VAO when first drawn, so any thread can add one
+	struct Chunk {
+		void*			storage;	// the whole mapped ring, or the staging array
+		unsigned char*	data;		// the current frame's copy
+		unsigned int	count;
+		unsigned int	vao;
+		unsigned int	vbo;
+		bool			mapped;		// persistently, written in place and never uploaded
+	};
+
+	enum StreamType {
+		LINES,
+		TRIS,
+		TRANSPARENT_TRIS,
+		LINES_2D,
+		TRIS_2D,
+		STREAM_TYPES,
+	};
+
+	// every primitive of one type, filled a chunk at a time
+	struct Stream {
+		StreamType			type;
+		unsigned int		vertices;	// per primitive
+		unsigned int		chunkSize;	// primitives per chunk
+		unsigned int		count;		// primitives this frame
+		unsigned int		current;	// chunk being filled
+		bool				uploaded;	// since the last clear, so drawing twice doesn't upload twice
+		bool				persistent;	// chunks are added as mapped rings, which needs the context so is only ever the immediate creating thread's
+		std::vector<Chunk>	chunks;
+	};
+
+	void			initStream(Stream& a_stream, StreamType a_type, unsigned int a_vertices, bool a_persistent);
+	void			destroyStream(Stream& a_stream);
+	bool			addChunk(Stream& a_stream);
+	void			createChunkBuffers(Stream& a_stream, Chunk& a_chunk);
+
+	// space for one more primitive in the calling thread's stream, or nullptr if it had to be dropped
+	unsigned char*	allocate(StreamType a_type);
+
+	// contiguous space for up to a_count primitives, a_granted is how many fit before the chunk ends
+	// returns nullptr, counting all a_count as dropped, once every chunk is full
+	unsigned char*	reserve(StreamType a_type, size_t a_count, size_t& a_granted);
+
+	void			writeLines(unsigned char* a_dst, const LineDesc* a_lines, size_t a_count) const;
+	void			writeTris(unsigned char* a_dst, const TriDesc* a_tris, size_t a_count) const;
+
+	struct Frame;
+
+	// uploads and draws every chunk in use
+	void			drawStream(Frame& a_frame, StreamType a_type, unsigned int a_mode);
+
+	// one type of a static batch, vertices are only kept on the CPU while recording
+	struct StaticBuffer {
+		std::vector<unsigned char>	recording;
+		unsigned int				count;
+		unsigned int				vao;
+		unsigned int				vbo;
+	};
+
+	struct StaticBatch {
+		std::string		name;
+		StaticBuffer	buffers[STREAM_TYPES];
+		bool			removed;	// deferred, a removal waiting for draw rather than a recording
+	};
+
+	StaticBatch*	findStatic(const char* a_name);
+	void			uploadStatic(StaticBatch& a_batch);
+	void			destroyStatic(StaticBatch& a_batch);
+
+	// deferred, applies the batches recorded and removed since the last draw
+	void			applyStaticChanges();
+
+	enum ShapeType {
+		SHAPE_SPHERE,
+		SHAPE_CYLINDER,
+		SHAPE_DISK,
+		SHAPE_RING,
+	};
+
+	// per instance attributes of a cached unit mesh
+	struct ShapeInstance {
+		float			rows[3][4];		// affine transform, rotation and scale with the centre in w
+		float			params[2];		// the unit vertex's w blends between these to scale it, e.g. inner and outer radius
+		unsigned char	colour[4];
+	};
+
+	// unit vertices for one shape and tessellation, uploaded the first time it's drawn
+	// meshes are only ever appended to a fixed array, so they never move while other threads use them
+	static const unsigned int MAX_SHAPE_MESHES = 64;
+	struct ShapeMesh {
+		ShapeType		type;
+		unsigned int	segments;	// columns for spheres
+		unsigned int	rows;		// spheres only
+		unsigned int	vao;
+		unsigned int	vbo;
+		unsigned int	lineFirst, lineVertices;
+		unsigned int	triFirst, triVertices;
+		std::vector<glm::vec4>	unit;	// lines then triangles, until uploaded
+	};
+
+	// a mesh's instances in one frame, by LINES, TRIS and TRANSPARENT_TRIS
+	static const unsigned int SHAPE_KINDS = TRANSPARENT_TRIS + 1;
+	struct ShapeInstances {
+		std::vector<ShapeInstance>	kinds[SHAPE_KINDS];
+		unsigned int				uploadFirst[SHAPE_KINDS];	// where they start in the instance buffer
+	};
+
+	// everything added between one clear and the next, deferred Gizmos hand it to draw whole
+	struct Frame {
+		Stream						streams[STREAM_TYPES];
+		std::vector<ShapeInstances>	shapes;		// by index in m_shapeMeshes
+		unsigned int				shapeCounts[SHAPE_KINDS];
+		Stats						stats;
+	};
+
+	void			initFrame(Frame& a_frame, bool a_persistent);
+	void			destroyFrame(Frame& a_frame);
+	void			resetFrame(Frame& a_frame);
+
+	// what one thread adds between two clears, a thread takes back the one it had the first time it adds
+	// after a clear, or any another thread has finished with, so threads that come and go don't pile them up
+	struct Context {
+		std::atomic<unsigned int>	epoch;			// the clear it was last taken after
+		Frame						frame;
+		StaticBatch*				recording;		// the batch between beginStatic and endStatic
+		std::vector<unsigned char>	lodLevels;		// this frame's, in the order shapes were added
+		std::vector<unsigned char>	lodPrevious;	// last frame's
 	};
 
-	struct GizmoTri {
-		GizmoVertex v0;
-		GizmoVertex v1;
-		GizmoVertex v2;
+	// the calling thread's context, only locks when it can't have the one it had before
+	Context&		context();
+
+	// cached per thread, with the Gizmos it came from so one from before a destroy is never used
+	struct ThreadContext {
+		unsigned int	instance;
+		unsigned int	epoch;
+		Context*		context;
 	};
 
+	// the frames draw and draw2D read, one per context
+	std::vector<Frame*>&	drawnFrames();
+
+	// the stats of every frame added together
+	Stats			sumStats(const std::vector<Frame*>& a_frames) const;
+
+	// true if a shape inside the sphere can't be seen, a_transform may scale it
+	// these and the rest of the add path work on the calling thread's context
+	bool			culled(const glm::vec3& a_center, float a_radius, const glm::mat4* a_transform);
+
+	// how many times to halve a_segments for a curve a_length long around a_center, never going below
+	// a_minSegments, shapes are matched to last frame's by the order they're added in for the hysteresis
+	unsigned int	lodLevel(const glm::vec3& a_center, float a_length, const glm::mat4* a_transform,
+							 unsigned int a_segments, unsigned int a_minSegments);
+
+	// finds or builds the unit mesh, nullptr while recording a static batch
+	ShapeMesh*		shapeMesh(ShapeType a_type, unsigned int a_segments, unsigned int a_rows);
+	void			addShape(ShapeMesh& a_mesh, StreamType a_kind, const glm::vec3& a_center, const glm::vec3& a_scale,
+							 const glm::mat4* a_transform, float a_param0, float a_param1, const glm::vec4& a_colour);
+
+	// uploads every instance in the frames in one go, then draws a kind of every mesh
+	void			uploadShapes(const std::vector<Frame*>& a_frames);
+	void			drawShapes(Frame& a_frame, StreamType a_kind, unsigned int a_mode, const glm::mat4& a_projectionView);
+	void			createShapeBuffers(ShapeMesh& a_mesh);
+
+	// draws a type from every static batch
+	void			drawStatic(Frame& a_frame, StreamType a_type, unsigned int a_mode);
+	unsigned int	staticCount(StreamType a_type) const;
+
+	// creates an immutable, persistently mapped VBO for a_copies copies of a_bytes
+	static void*	createPersistentBuffer(unsigned int& a_vbo, size_t a_bytes, unsigned int a_copies);
+
+	// deferred, on the drawing thread, moves a frame's staged chunks into mapped VBOs of their own
+	void			mapFrame(Frame& a_frame);
+
+	// points the add functions at the current frame's copy
+	void			selectFrame();
+
+	VertexFormat	m_format;
+	unsigned int	m_vertexSize;	// bytes
+
+	bool			m_persistent;
+	unsigned int	m_frame;
+	void*			m_fences[FRAME_COUNT];	// GLsync, signalled once a frame's copy has been drawn
+	void*			m_drawnFence;			// deferred, GLsync, signalled once everything drawn before the last acquire has been
+
 	unsigned int	m_shader;
+	unsigned int	m_shapeShader;
+	int				m_projectionViewUniform;
+	int				m_shapeProjectionViewUniform;
 
-	// line data
-	unsigned int	m_maxLines;
-	unsigned int	m_lineCount;
-	GizmoLine*		m_lines;
+	unsigned int				m_chunkSizes[STREAM_TYPES];	// primitives per chunk
 
-	unsigned int	m_lineVAO;
-	unsigned int 	m_lineVBO;
+	// what the add functions write to, the creating thread's is first, each frame is drawn directly unless deferred
+	std::vector<Context*>		m_contexts;
+	std::mutex					m_contextMutex;
+	unsigned int				m_instance;		// tells a thread's cached context from one of an earlier Gizmos
+	unsigned int				m_epoch;		// clears so far
+	std::atomic<unsigned int>	m_chunks;		// allocated, across every frame
 
-	// triangle data
-	unsigned int	m_maxTris;
-	unsigned int	m_triCount;
-	GizmoTri*		m_tris;
+	Stats						m_lastStats;
+	std::vector<Frame*>			m_drawn;
 
-	unsigned int	m_triVAO;
-	unsigned int 	m_triVBO;
-	
-	unsigned int	m_transparentTriCount;
-	GizmoTri*		m_transparentTris;
+	// deferred, published frames swap with the contexts' so nothing is copied
+	bool							m_deferred;
+	bool							m_cleared;	// since the last publish
+	TripleBuffer<std::vector<Frame>>	m_frames;
 
-	unsigned int	m_transparentTriVAO;
-	unsigned int 	m_transparentTriVBO;
-	
-	// 2D line data
-	unsigned int	m_max2DLines;
-	unsigned int	m_2DlineCount;
-	GizmoLine*		m_2Dlines;
+	std::vector<StaticBatch>	m_staticBatches;	// owned by the drawing thread when deferred
+	StaticBatch					m_deferredRecording;
+	std::vector<StaticBatch>	m_staticChanges;	// deferred, recorded and removed batches for draw to apply
+	std::mutex					m_staticMutex;
 
-	unsigned int	m_2DlineVAO;
-	unsigned int 	m_2DlineVBO;
+	ShapeMesh					m_shapeMeshes[MAX_SHAPE_MESHES];
+	std::atomic<unsigned int>	m_shapeMeshCount;	// released after a mesh is built, so it's complete to any thread that sees it
+	std::mutex					m_shapeMutex;		// only taken to build a mesh
+	std::vector<ShapeInstance>	m_shapeUpload;
+	unsigned int				m_shapeVBO;
 
-	// 2D triangle data
-	unsigned int	m_max2DTris;
-	unsigned int	m_2DtriCount;
-	GizmoTri*		m_2Dtris;
+	const Camera*				m_camera;
 
-	unsigned int	m_2DtriVAO;
-	unsigned int 	m_2DtriVBO;
+	float						m_lodViewportHeight;
+	float						m_lodSegmentPixels;
 
 	static Gizmos*	sm_singleton;
+	static unsigned int	sm_instances;
+	static thread_local ThreadContext	sm_threadContext;
 };
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "LatencyTracer.h"
+#include "gl_core_4_4.h"
+#include <algorithm>
+#include <iostream>
+#include <GetTime.h>
+
+const float LatencyTracer::REPORT_INTERVAL = 5.0f;
+
+LatencyTracer::LatencyTracer()
+	: m_timestamps(false),
+	m_gpuOffset(0),
+	m_drawnAt(0),
+	m_first(0),
+	m_count(0),
+	m_lastReport(0) {
+	for (auto& pending : m_pending)
+		pending.query = 0;
+	for (auto& percentiles : m_percentiles)
+		percentiles = Percentiles{ 0, 0, 0, 0, 0 };
+}
+
+LatencyTracer::~LatencyTracer() {
+}
+
+long long LatencyTracer::now() {
+	return (long long)RakNet::GetTimeUS();
+}
+
+bool LatencyTracer::create() {
+	// timestamp queries are core, but a driver may still report a counter with no bits
+	int bits = 0;
+	if (glQueryCounter != nullptr && glGetQueryObjectui64v != nullptr && glGetInteger64v != nullptr)
+		glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	m_timestamps = bits > 0;
+
+	if (m_timestamps) {
+		unsigned int queries[MAX_PENDING];
+		glGenQueries(MAX_PENDING, queries);
+		for (unsigned int i = 0; i < MAX_PENDING; ++i)
+			m_pending[i].query = queries[i];
+		calibrate();
+	}
+	else
+		std::cout << "No GL timestamp queries, latency is traced to the swap returning" << std::endl;
+
+	m_drawn = Trace();
+	m_first = m_count = 0;
+	m_lastReport = now();
+	return true;
+}
+
+void LatencyTracer::destroy() {
+	if (m_timestamps) {
+		for (auto& pending : m_pending) {
+			glDeleteQueries(1, &pending.query);
+			pending.query = 0;
+		}
+	}
+	m_timestamps = false;
+}
+
+void LatencyTracer::drawn(const Trace& trace) {
+	m_drawn = trace;
+	m_drawnAt = now();
+}
+
+void LatencyTracer::swapped() {
+	long long swapTime = now();
+
+	// the GPU reaches the query once everything before the swap is done
+	if (m_drawn.applied != 0 && m_count < MAX_PENDING) {
+		Pending& pending = m_pending[(m_first + m_count) % MAX_PENDING];
+		++m_count;
+		pending.trace = m_drawn;
+		pending.drawn = m_drawnAt;
+		pending.swapped = swapTime;
+		if (m_timestamps)
+			glQueryCounter(pending.query, GL_TIMESTAMP);
+	}
+	m_drawn = Trace();
+
+	// queries finish in order, so stop at the first that hasn't, rather than waiting on it
+	while (m_count > 0) {
+		const Pending& pending = m_pending[m_first];
+		long long presented = pending.swapped;
+		if (m_timestamps) {
+			int available = 0;
+			glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == 0)
+				break;
+
+			GLuint64 gpuTime = 0;
+			glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &gpuTime);
+			presented = (long long)(gpuTime / 1000) + m_gpuOffset;
+		}
+
+		record(pending, presented);
+		m_first = (m_first + 1) % MAX_PENDING;
+		--m_count;
+	}
+
+	if (swapTime - m_lastReport >= (long long)(REPORT_INTERVAL * 1000000)) {
+		m_lastReport = swapTime;
+		report();
+
+		// the two clocks drift apart, so they're lined up again every report
+		if (m_timestamps)
+			calibrate();
+	}
+}
+
+void LatencyTracer::record(const Pending& pending, long long presented) {
+	const Trace& trace = pending.trace;
+	m_samples[NETWORK].push_back((trace.received - trace.sent) / 1000.0f);
+	m_samples[APPLY].push_back((trace.applied - trace.received) / 1000.0f);
+	m_samples[DRAW].push_back((pending.drawn - trace.applied) / 1000.0f);
+	m_samples[PRESENT].push_back((presented - pending.drawn) / 1000.0f);
+	m_samples[TOTAL].push_back((presented - trace.sent) / 1000.0f);
+}
+
+void LatencyTracer::report() {
+	if (m_samples[TOTAL].empty())
+		return;
+
+	for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+		std::vector<float>& samples = m_samples[stage];
+		std::sort(samples.begin(), samples.end());
+
+		size_t last = samples.size() - 1;
+		auto percentile = [&](float p) { return samples[(size_t)(last * p + 0.5f)]; };
+		m_percentiles[stage] = Percentiles{ percentile(0.5f), percentile(0.95f), percentile(0.99f),
+											samples[last], (unsigned int)samples.size() };
+		samples.clear();
+	}
+
+	const char* names[STAGE_COUNT] = { "network", "apply", "draw", "present", "total" };
+	std::cout << "Latency (ms) over " << m_percentiles[TOTAL].snapshots << " snapshots, 50% / 95% / 99% / max:";
+	for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+		const Percentiles& percentiles = m_percentiles[stage];
+		std::cout << (stage > 0 ? ", " : " ") << names[stage] << " " << percentiles.p50 << " / " << percentiles.p95 <<
+			" / " << percentiles.p99 << " / " << percentiles.max;
+	}
+	std::cout << std::endl;
+}
+
+void LatencyTracer::calibrate() {
+	// the time the GPU has got to once everything issued so far reaches it, close enough to now
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	m_gpuOffset = now() - gpuTime / 1000;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+
+// how stale what's on screen is, following snapshots from the server stepping to their tick through
+// being received, applied and drawn to being presented, with percentiles for each stage printed every
+// REPORT_INTERVAL seconds, so it's clear whether the network, the filter or the render pipeline is to blame
+// times are microseconds on RakNet::GetTimeUS, which the server's tick times are converted onto
+class LatencyTracer {
+public:
+
+	// where one snapshot has got to, carried along with it from the network thread to the drawing thread
+	struct Trace {
+		Trace() : sent(0), received(0), applied(0) {}
+
+		long long	sent;		// the server stepped to the tick, as near as the clock differential gets it
+		long long	received;	// decoded on the network thread
+		long long	applied;	// filtered into the entity state, 0 if there's nothing to trace
+	};
+
+	enum Stage {
+		NETWORK,	// sent to received, the server's queueing, the link and decoding
+		APPLY,		// received to applied, waiting for an update to take it
+		DRAW,		// applied to drawn, waiting for a frame to be published and issuing its GL
+		PRESENT,	// drawn to presented, the GPU finishing the frame, or the swap returning without timer queries
+		TOTAL,		// sent to presented
+		STAGE_COUNT,
+	};
+
+	// milliseconds, over the snapshots presented since the last report
+	struct Percentiles {
+		float			p50;
+		float			p95;
+		float			p99;
+		float			max;
+		unsigned int	snapshots;
+	};
+
+	LatencyTracer();
+	~LatencyTracer();
+
+	// the same clock as the traces, on any thread
+	static long long	now();
+
+	// needs a current GL context, which has to be current on the drawing thread from then on
+	// presents are timed with GL timestamp queries if the driver has them
+	bool	create();
+	void	destroy();
+
+	// on the drawing thread once the frame showing trace's snapshot for the first time is issued
+	void	drawn(const Trace& trace);
+
+	// on the drawing thread straight after every swap
+	void	swapped();
+
+	// the last report printed
+	const Percentiles&	getPercentiles(Stage stage) const	{ return m_percentiles[stage]; }
+
+private:
+
+	static const float			REPORT_INTERVAL;
+
+	// frames swapped whose GPU timestamps haven't come back yet, past this many frames go untraced
+	static const unsigned int	MAX_PENDING = 8;
+
+	struct Pending {
+		Trace		trace;
+		long long	drawn;
+		long long	swapped;
+		unsigned int query;
+	};
+
+	void	record(const Pending& pending, long long presented);
+	void	report();
+
+	// the GPU's clock less ours, read back with glGetInteger64v
+	void	calibrate();
+
+	bool			m_timestamps;
+	long long		m_gpuOffset;	// microseconds to add to a GPU timestamp to get our time
+
+	Trace			m_drawn;		// in the frame being drawn, applied is 0 if it has no new snapshot
+	long long		m_drawnAt;
+
+	Pending			m_pending[MAX_PENDING];
+	unsigned int	m_first;
+	unsigned int	m_count;
+
+	std::vector<float>	m_samples[STAGE_COUNT];	// since the last report
+	long long			m_lastReport;
+	Percentiles			m_percentiles[STAGE_COUNT];
+};
@@ -0,0 +1,142 @@
+#include "NetworkTelemetry.h"
+#include "EntityState.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+static const long long NANOSECONDS_PER_SECOND = 1000000000;
+
+NetworkTelemetry::NetworkTelemetry()
+	: m_lastArrival(0),
+	m_highestTick(0),
+	m_snapshots(0),
+	m_outOfOrder(0),
+	m_late(0),
+	m_lostTicks(0),
+	m_bytesPerSecond(0),
+	m_packetLoss(0),
+	m_ping(0),
+	m_averagePing(0),
+	m_start(0),
+	m_secondStart(0),
+	m_seconds(SECONDS),
+	m_next(0),
+	m_count(0) {
+	for (auto& arrivals : m_arrivals)
+		arrivals = 0;
+
+	// a second's worth at 60 snapshots a second, so the samples don't normally reallocate
+	m_corrections.reserve(CORRECTION_SAMPLES * 60);
+}
+
+void NetworkTelemetry::arrived(unsigned int tick) {
+	long long now = Profiler::now();
+	if (m_lastArrival != 0) {
+		long long milliseconds = (now - m_lastArrival) / 1000000;
+		unsigned int bucket = (unsigned int)std::min(milliseconds / ARRIVAL_BUCKET_MS, (long long)ARRIVAL_BUCKETS - 1);
+		++m_arrivals[bucket];
+	}
+	m_lastArrival = now;
+	++m_snapshots;
+
+	// the server sends every tick, so a gap is taken as loss until the ticks in it turn up
+	if (m_highestTick != 0 && tick <= m_highestTick) {
+		++m_outOfOrder;
+		if (tick < m_highestTick)
+			--m_lostTicks;
+	}
+	else {
+		if (m_highestTick != 0)
+			m_lostTicks += (int)(tick - m_highestTick - 1);
+		m_highestTick = tick;
+	}
+}
+
+void NetworkTelemetry::link(unsigned int bytesPerSecond, float packetLoss, int ping, int averagePing) {
+	m_bytesPerSecond = bytesPerSecond;
+	m_packetLoss = packetLoss;
+	m_ping = ping;
+	m_averagePing = averagePing;
+}
+
+void NetworkTelemetry::late() {
+	++m_late;
+}
+
+void NetworkTelemetry::corrections(const EntityState& state, const AIEntity* snapshot, size_t count) {
+	const EntityStateBuffer& predicted = state.current();
+	size_t stride = (count + CORRECTION_SAMPLES - 1) / CORRECTION_SAMPLES;
+	for (size_t s = 0; s < count; s += stride) {
+		size_t i = state.indexOf(snapshot[s].id);
+		if (i == SlotMap<AIEntity>::npos)
+			continue;
+
+		float dx = snapshot[s].position.x - predicted.positionX[i];
+		float dy = snapshot[s].position.y - predicted.positionY[i];
+		m_corrections.push_back(std::sqrt(dx * dx + dy * dy));
+	}
+}
+
+void NetworkTelemetry::update() {
+	long long now = Profiler::now();
+	if (m_start == 0)
+		m_start = m_secondStart = now;
+	if (now - m_secondStart < NANOSECONDS_PER_SECOND)
+		return;
+	m_secondStart = now;
+
+	Second& second = m_seconds[m_next];
+	m_next = (m_next + 1) % SECONDS;
+	if (m_count < SECONDS)
+		++m_count;
+
+	second.time = (float)(now - m_start) / NANOSECONDS_PER_SECOND;
+	second.bytesReceived = m_bytesPerSecond.load();
+	second.snapshots = m_snapshots.exchange(0);
+	for (unsigned int i = 0; i < ARRIVAL_BUCKETS; ++i)
+		second.arrivals[i] = m_arrivals[i].exchange(0);
+	second.outOfOrder = m_outOfOrder.exchange(0);
+	second.late = m_late.exchange(0);
+	second.lostTicks = m_lostTicks.exchange(0);
+	second.packetLoss = m_packetLoss.load();
+	second.ping = m_ping.load();
+	second.averagePing = m_averagePing.load();
+
+	second.corrections = (unsigned int)m_corrections.size();
+	second.correctionMean = second.correctionP95 = second.correctionMax = 0;
+	if (m_corrections.empty() == false) {
+		second.correctionMean = std::accumulate(m_corrections.begin(), m_corrections.end(), 0.0f) / m_corrections.size();
+		second.correctionMax = *std::max_element(m_corrections.begin(), m_corrections.end());
+		auto p95 = m_corrections.begin() + (size_t)((m_corrections.size() - 1) * 0.95f);
+		std::nth_element(m_corrections.begin(), p95, m_corrections.end());
+		second.correctionP95 = *p95;
+		m_corrections.clear();
+	}
+}
+
+bool NetworkTelemetry::writeCSV(const char* path) const {
+	FILE* file = fopen(path, "w");
+	if (file == nullptr)
+		return false;
+
+	fputs("time,bytes_received,snapshots", file);
+	for (unsigned int i = 0; i < ARRIVAL_BUCKETS - 1; ++i)
+		fprintf(file, ",arrivals_%u_%ums", i * ARRIVAL_BUCKET_MS, (i + 1) * ARRIVAL_BUCKET_MS);
+	fprintf(file, ",arrivals_%ums_up", (ARRIVAL_BUCKETS - 1) * ARRIVAL_BUCKET_MS);
+	fputs(",out_of_order,late,lost_ticks,packet_loss,ping,average_ping,corrections,correction_mean,correction_p95,correction_max\n", file);
+
+	for (size_t i = 0; i < size(); ++i) {
+		const Second& second = at(i);
+		fprintf(file, "%.3f,%u,%u", second.time, second.bytesReceived, second.snapshots);
+		for (unsigned int arrivals : second.arrivals)
+			fprintf(file, ",%u", arrivals);
+		fprintf(file, ",%u,%u,%d,%.4f,%d,%d,%u,%.4f,%.4f,%.4f\n", second.outOfOrder, second.late, second.lostTicks,
+				second.packetLoss, second.ping, second.averagePing,
+				second.corrections, second.correctionMean, second.correctionP95, second.correctionMax);
+	}
+
+	fclose(file);
+	return true;
+}
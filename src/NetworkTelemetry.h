@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+struct AIEntity;
+class EntityState;
+
+// how the link to the server behaved, a row a second for the last SECONDS, so the smoothing and
+// snapshot settings can be tuned against real connections rather than by eye
+// the network thread reports arrivals and RakNet's view of the link, the main thread what happened
+// when snapshots were applied, and the main thread owns the rows
+class NetworkTelemetry {
+public:
+
+	static const unsigned int SECONDS = 3600;
+
+	// the gaps between snapshot arrivals, ARRIVAL_BUCKET_MS wide with the last open ended
+	static const unsigned int ARRIVAL_BUCKETS = 8;
+	static const unsigned int ARRIVAL_BUCKET_MS = 8;
+
+	// per snapshot entities compared to their prediction, spread evenly through it
+	static const unsigned int CORRECTION_SAMPLES = 256;
+
+	struct Second {
+		float			time;			// since the first row started, at the end of this one
+		unsigned int	bytesReceived;	// by RakNet over the second, headers and all
+		unsigned int	snapshots;		// decoded by the network thread
+		unsigned int	arrivals[ARRIVAL_BUCKETS];
+		unsigned int	outOfOrder;		// arrived with an older tick than one before them
+		unsigned int	late;			// no newer than one already handed over, so discarded
+		int				lostTicks;		// skipped over, less any that turned up late after all
+		float			packetLoss;		// RakNet's estimate over the second, 0 to 1
+		int				ping;			// milliseconds round trip, the last measured
+		int				averagePing;
+		unsigned int	corrections;	// entities sampled
+		float			correctionMean;	// how far the prediction was from the snapshot, in world units
+		float			correctionP95;
+		float			correctionMax;
+	};
+
+	NetworkTelemetry();
+
+	// on the network thread, a snapshot for tick was decoded
+	void	arrived(unsigned int tick);
+
+	// on the network thread, a decoded snapshot was no newer than one already handed to the main thread
+	void	late();
+
+	// on the network thread, RakNet's statistics for the server, about once a second
+	void	link(unsigned int bytesPerSecond, float packetLoss, int ping, int averagePing);
+
+	// on the main thread, before snapshot is filtered into state
+	void	corrections(const EntityState& state, const AIEntity* snapshot, size_t count);
+
+	// on the main thread, adds a row once a second has passed since the last, call every update
+	void	update();
+
+	// rows oldest first, on the main thread
+	size_t			size() const				{ return m_count; }
+	const Second&	at(size_t index) const		{ return m_seconds[(m_next + SECONDS - m_count + index) % SECONDS]; }
+
+	// every row, false if the file can't be opened
+	bool	writeCSV(const char* path) const;
+
+private:
+
+	// network thread only
+	long long					m_lastArrival;
+	unsigned int				m_highestTick;
+
+	// from the network thread, taken by update
+	std::atomic<unsigned int>	m_snapshots;
+	std::atomic<unsigned int>	m_arrivals[ARRIVAL_BUCKETS];
+	std::atomic<unsigned int>	m_outOfOrder;
+	std::atomic<unsigned int>	m_late;
+	std::atomic<int>			m_lostTicks;
+	std::atomic<unsigned int>	m_bytesPerSecond;
+	std::atomic<float>			m_packetLoss;
+	std::atomic<int>			m_ping;
+	std::atomic<int>			m_averagePing;
+
+	// main thread only
+	std::vector<float>			m_corrections;	// this second's samples
+
+	long long					m_start;
+	long long					m_secondStart;
+	std::vector<Second>			m_seconds;
+	unsigned int				m_next;
+	unsigned int				m_count;
+};
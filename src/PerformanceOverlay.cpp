@@ -0,0 +1,293 @@
+#include "PerformanceOverlay.h"
+#include "gl_core_4_4.h"
+#include "RenderState.h"
+#include "Profiler.h"
+#include <imgui.h>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+// attribute locations, also bound by name below
+enum {
+	ATTRIBUTE_POSITION,
+	ATTRIBUTE_TEXCOORD,
+	ATTRIBUTE_COLOUR,
+};
+
+static const float GRAPH_WIDTH = 240;
+static const float GRAPH_HEIGHT = 32;
+
+static const char* vsSource = "#version 330\n \
+					 in vec2 Position; \
+					 in vec2 TexCoord; \
+					 in vec4 Colour; \
+					 uniform mat4 Projection; \
+					 out vec2 vTexCoord; \
+					 out vec4 vColour; \
+					 void main() { \
+						vTexCoord = TexCoord; \
+						vColour = Colour; \
+						gl_Position = Projection * vec4(Position, 0, 1); }";
+
+// the font atlas is alpha only
+static const char* fsSource = "#version 330\n \
+					 uniform sampler2D Font; \
+					 in vec2 vTexCoord; \
+					 in vec4 vColour; \
+					 out vec4 FragColor; \
+					 void main() { \
+						FragColor = vec4(vColour.rgb, vColour.a * texture(Font, vTexCoord).r); }";
+
+PerformanceOverlay::PerformanceOverlay()
+	: m_shader(0),
+	m_projectionUniform(-1),
+	m_vao(0),
+	m_vbo(0),
+	m_ibo(0),
+	m_fontTexture(0),
+	m_next(0),
+	m_lastFrame(0),
+	m_overlay(0) {
+	memset(m_history, 0, sizeof(m_history));
+	memset(m_seconds, 0, sizeof(m_seconds));
+	memset(m_snapshots, 0, sizeof(m_snapshots));
+	memset(&m_last, 0, sizeof(m_last));
+}
+
+PerformanceOverlay::~PerformanceOverlay() {
+}
+
+bool PerformanceOverlay::create() {
+	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
+	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
+
+	glShaderSource(vs, 1, (const char**)&vsSource, 0);
+	glCompileShader(vs);
+
+	glShaderSource(fs, 1, (const char**)&fsSource, 0);
+	glCompileShader(fs);
+
+	m_shader = glCreateProgram();
+	glAttachShader(m_shader, vs);
+	glAttachShader(m_shader, fs);
+	glBindAttribLocation(m_shader, ATTRIBUTE_POSITION, "Position");
+	glBindAttribLocation(m_shader, ATTRIBUTE_TEXCOORD, "TexCoord");
+	glBindAttribLocation(m_shader, ATTRIBUTE_COLOUR, "Colour");
+	glLinkProgram(m_shader);
+
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+
+	int success = GL_FALSE;
+	glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE) {
+		int infoLogLength = 0;
+		glGetProgramiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
+		char* infoLog = new char[infoLogLength + 1];
+		infoLog[0] = 0;
+
+		glGetProgramInfoLog(m_shader, infoLogLength + 1, 0, infoLog);
+		printf("Error: Failed to link overlay shader program!\n%s\n", infoLog);
+		delete[] infoLog;
+
+		destroy();
+		return false;
+	}
+
+	m_projectionUniform = RenderState::uniformLocation(m_shader, "Projection");
+
+	// the sampler stays on unit 0
+	RenderState::useProgram(m_shader);
+	glUniform1i(RenderState::uniformLocation(m_shader, "Font"), 0);
+
+	// the index buffer binding is part of the vao
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vbo);
+	glGenBuffers(1, &m_ibo);
+	RenderState::bindVertexArray(m_vao);
+	RenderState::bindArrayBuffer(m_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glEnableVertexAttribArray(ATTRIBUTE_POSITION);
+	glEnableVertexAttribArray(ATTRIBUTE_TEXCOORD);
+	glEnableVertexAttribArray(ATTRIBUTE_COLOUR);
+	glVertexAttribPointer(ATTRIBUTE_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (void*)offsetof(ImDrawVert, pos));
+	glVertexAttribPointer(ATTRIBUTE_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (void*)offsetof(ImDrawVert, uv));
+	glVertexAttribPointer(ATTRIBUTE_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (void*)offsetof(ImDrawVert, col));
+	RenderState::bindVertexArray(0);
+
+	// nothing is clicked or typed, so no input is passed on, and nothing is saved between runs
+	ImGuiIO& io = ImGui::GetIO();
+	io.IniFilename = nullptr;
+	io.RenderDrawListsFn = nullptr;
+
+	unsigned char* pixels = nullptr;
+	int width = 0, height = 0;
+	io.Fonts->GetTexDataAsAlpha8(&pixels, &width, &height);
+	glGenTextures(1, &m_fontTexture);
+	glBindTexture(GL_TEXTURE_2D, m_fontTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	io.Fonts->TexID = (void*)(intptr_t)m_fontTexture;
+	io.Fonts->ClearTexData();
+	return true;
+}
+
+void PerformanceOverlay::destroy() {
+	// imgui was set up along with the font
+	if (m_fontTexture != 0) {
+		glDeleteTextures(1, &m_fontTexture);
+		ImGui::Shutdown();
+	}
+	if (m_ibo != 0)
+		RenderState::deleteBuffer(m_ibo);
+	if (m_vbo != 0)
+		RenderState::deleteBuffer(m_vbo);
+	if (m_vao != 0)
+		RenderState::deleteVertexArray(m_vao);
+	if (m_shader != 0)
+		RenderState::deleteProgram(m_shader);
+	m_fontTexture = m_ibo = m_vbo = m_vao = m_shader = 0;
+}
+
+void PerformanceOverlay::addFrame(const Sample& sample, float submit, unsigned int primitives) {
+	long long now = Profiler::now();
+	float seconds = m_lastFrame != 0 ? (now - m_lastFrame) / 1000000000.0f : 0;
+	m_lastFrame = now;
+
+	int frame = m_next;
+	m_next = (m_next + 1) % HISTORY;
+
+	m_history[UPDATE][frame] = sample.update;
+	m_history[RECEIVE][frame] = sample.receive;
+	m_history[FILTER][frame] = sample.filter;
+	m_history[GIZMOS][frame] = sample.gizmos;
+	m_history[SUBMIT][frame] = submit;
+	m_history[OVERLAY][frame] = m_overlay;
+	m_history[PRIMITIVES][frame] = (float)primitives;
+	m_history[LATE][frame] = sample.late >= m_last.late ? (float)(sample.late - m_last.late) : 0;
+	m_history[ALLOCATIONS][frame] = (float)sample.allocations;
+
+	// snapshots a second, over the frames making up about the last second
+	m_seconds[frame] = seconds;
+	m_snapshots[frame] = sample.snapshots;
+	float elapsed = 0;
+	unsigned int snapshots = 0;
+	for (int i = 0; i < HISTORY && elapsed < 1; ++i) {
+		int previous = (frame + HISTORY - i) % HISTORY;
+		elapsed += m_seconds[previous];
+		snapshots += m_snapshots[previous];
+	}
+	m_history[SNAPSHOT_RATE][frame] = elapsed > 0 ? snapshots / elapsed : 0;
+
+	m_last = sample;
+}
+
+void PerformanceOverlay::plot(Graph graph, const char* label, const char* format) {
+	const float* values = m_history[graph];
+	float most = 0;
+	for (int i = 0; i < HISTORY; ++i)
+		most = values[i] > most ? values[i] : most;
+
+	// the newest value and the largest still on the graph
+	char text[64];
+	snprintf(text, sizeof(text), format, values[(m_next + HISTORY - 1) % HISTORY], most);
+	ImGui::PlotLines(label, values, HISTORY, m_next, text, 0, most > 0 ? most : 1, ImVec2(GRAPH_WIDTH, GRAPH_HEIGHT));
+}
+
+void PerformanceOverlay::draw(int width, int height) {
+	if (m_shader == 0 || width <= 0 || height <= 0)
+		return;
+	long long start = Profiler::now();
+
+	// there's nothing animated, so the time step doesn't matter
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2((float)width, (float)height);
+	io.DeltaTime = 1 / 60.0f;
+	ImGui::NewFrame();
+
+	ImGui::SetNextWindowPos(ImVec2(10, 10));
+	ImGui::Begin("Performance", nullptr, ImVec2(0, 0), 0.6f,
+				 ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove |
+				 ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoInputs | ImGuiWindowFlags_AlwaysAutoResize);
+	plot(UPDATE, "update", "%.2f ms, max %.2f");
+	plot(RECEIVE, "receive", "%.2f ms, max %.2f");
+	plot(FILTER, "filter", "%.2f ms, max %.2f");
+	plot(GIZMOS, "Gizmos build", "%.2f ms, max %.2f");
+	plot(SUBMIT, "GL submit", "%.2f ms, max %.2f");
+	plot(OVERLAY, "overlay", "%.3f ms, max %.3f");
+	ImGui::Separator();
+	plot(PRIMITIVES, "Gizmos primitives", "%.0f, max %.0f");
+	plot(SNAPSHOT_RATE, "snapshots / s", "%.1f, max %.1f");
+	plot(LATE, "late snapshots", "%.0f, max %.0f");
+#ifdef COUNT_ALLOCATIONS
+	plot(ALLOCATIONS, "allocations", "%.0f, max %.0f");
+#endif
+	ImGui::Text("largest tick %d, late %u, dropped %u", m_last.largestTick, m_last.late, m_last.dropped);
+	ImGui::End();
+
+	ImGui::Render();
+	ImDrawData* data = ImGui::GetDrawData();
+	if (data->CmdListsCount == 0) {
+		m_overlay = (Profiler::now() - start) / 1000000.0f;
+		return;
+	}
+
+	bool blendEnabled = RenderState::isEnabled(RenderState::BLEND);
+	bool depthTestEnabled = RenderState::isEnabled(RenderState::DEPTH_TEST);
+	bool cullFaceEnabled = RenderState::isEnabled(RenderState::CULL_FACE);
+	unsigned int src, dst;
+	RenderState::getBlendFunc(src, dst);
+
+	RenderState::setEnabled(RenderState::BLEND, true);
+	RenderState::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	RenderState::setEnabled(RenderState::DEPTH_TEST, false);
+	RenderState::setEnabled(RenderState::CULL_FACE, false);
+	glEnable(GL_SCISSOR_TEST);
+
+	// pixels with y down, as imgui lays them out
+	const float projection[16] = {
+		2.0f / width, 0, 0, 0,
+		0, -2.0f / height, 0, 0,
+		0, 0, -1, 0,
+		-1, 1, 0, 1,
+	};
+	RenderState::useProgram(m_shader);
+	glUniformMatrix4fv(m_projectionUniform, 1, false, projection);
+	glBindTexture(GL_TEXTURE_2D, m_fontTexture);
+
+	// every list goes in the one pair of buffers, orphaned each frame, and is drawn from its offset
+	RenderState::bindVertexArray(m_vao);
+	RenderState::bindArrayBuffer(m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, data->TotalVtxCount * sizeof(ImDrawVert), nullptr, GL_STREAM_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, data->TotalIdxCount * sizeof(ImDrawIdx), nullptr, GL_STREAM_DRAW);
+
+	int vertices = 0;
+	int indices = 0;
+	for (int i = 0; i < data->CmdListsCount; ++i) {
+		const ImDrawList* list = data->CmdLists[i];
+		glBufferSubData(GL_ARRAY_BUFFER, vertices * sizeof(ImDrawVert), list->VtxBuffer.size() * sizeof(ImDrawVert), list->VtxBuffer.Data);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indices * sizeof(ImDrawIdx), list->IdxBuffer.size() * sizeof(ImDrawIdx), list->IdxBuffer.Data);
+
+		for (const ImDrawCmd& command : list->CmdBuffer) {
+			glScissor((int)command.ClipRect.x, (int)(height - command.ClipRect.w),
+					  (int)(command.ClipRect.z - command.ClipRect.x), (int)(command.ClipRect.w - command.ClipRect.y));
+			glDrawElementsBaseVertex(GL_TRIANGLES, command.ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+									 (void*)(indices * sizeof(ImDrawIdx)), vertices);
+			indices += command.ElemCount;
+		}
+		vertices += list->VtxBuffer.size();
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDisable(GL_SCISSOR_TEST);
+	RenderState::setBlendFunc(src, dst);
+	RenderState::setEnabled(RenderState::CULL_FACE, cullFaceEnabled);
+	RenderState::setEnabled(RenderState::DEPTH_TEST, depthTestEnabled);
+	RenderState::setEnabled(RenderState::BLEND, blendEnabled);
+
+	m_overlay = (Profiler::now() - start) / 1000000.0f;
+}
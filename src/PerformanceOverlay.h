@@ -0,0 +1,72 @@
+#pragma once
+
+// rolling graphs of where each frame's time goes, drawn with imgui over the top of everything else
+// all of it happens on the drawing thread, what the update thread measured arrives as a Sample, and
+// nothing needs calling while it's hidden
+class PerformanceOverlay {
+public:
+
+	PerformanceOverlay();
+	~PerformanceOverlay();
+
+	// needs a current GL context, which has to be current on the drawing thread from then on
+	bool	create();
+	void	destroy();
+
+	// one published frame as the update thread saw it, times in milliseconds
+	struct Sample {
+		float			update;			// every update the frame ran, including receive and filter
+		float			receive;		// handling the packets the network thread passed on
+		float			filter;			// moving the filtered entities on and applying snapshots to them
+		float			gizmos;			// clearing and publishing the Gizmos
+		unsigned int	snapshots;		// applied since the last sample
+		unsigned int	late;			// discarded as no newer than one already handed over, in total
+		unsigned int	dropped;		// replaced by a newer one before they were applied, in total
+		int				largestTick;
+		unsigned int	allocations;	// operator new calls since the last sample, on any thread
+	};
+
+	// adds a frame to the graphs, submit is how long issuing its GL took on the CPU and primitives
+	// the Gizmos lines and triangles it drew
+	void	addFrame(const Sample& sample, float submit, unsigned int primitives);
+
+	// over a width by height framebuffer, in pixels, the time this takes is graphed too
+	void	draw(int width, int height);
+
+private:
+
+	static const int HISTORY = 120;
+
+	enum Graph {
+		UPDATE,
+		RECEIVE,
+		FILTER,
+		GIZMOS,
+		SUBMIT,
+		OVERLAY,
+		PRIMITIVES,
+		SNAPSHOT_RATE,
+		LATE,
+		ALLOCATIONS,
+		GRAPH_COUNT,
+	};
+
+	void	plot(Graph graph, const char* label, const char* format);
+
+	unsigned int	m_shader;
+	int				m_projectionUniform;
+
+	unsigned int	m_vao;
+	unsigned int	m_vbo;
+	unsigned int	m_ibo;
+	unsigned int	m_fontTexture;
+
+	float			m_history[GRAPH_COUNT][HISTORY];
+	float			m_seconds[HISTORY];		// between each frame and the one before
+	unsigned int	m_snapshots[HISTORY];
+	int				m_next;					// oldest entry, written over by the next frame
+
+	Sample			m_last;
+	long long		m_lastFrame;
+	float			m_overlay;				// how long the last draw took
+};
@@ -0,0 +1,239 @@
+#include "Profiler.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::atomic<bool> Profiler::sm_enabled(false);
+
+namespace {
+
+struct Event {
+	const char*	name;
+	long long	start;
+	long long	end;
+};
+
+// relaxed, as a reader may copy one as it's overwritten and then throws it away
+struct RingEvent {
+	std::atomic<const char*>	name;
+	std::atomic<long long>		start;
+	std::atomic<long long>		end;
+};
+
+// only its thread writes to a ring, anything reading it checks written again afterwards
+// to throw away whatever was overwritten while it read
+struct Ring {
+	RingEvent						events[Profiler::RING_EVENTS];
+	std::atomic<unsigned long long>	written;
+	unsigned long long				rotated;	// events already in a rotating file
+	unsigned int					thread;		// the trace's tid
+	std::string						name;
+	bool							owned;		// by a running thread
+};
+
+// hands the ring back when its thread exits, so threads that come and go reuse them
+struct RingOwner {
+	Ring*	ring;
+	~RingOwner();
+};
+
+struct State {
+	std::mutex			mutex;		// rings, and everything below
+	std::vector<Ring*>	rings;
+	unsigned int		threads;
+	long long			start;
+
+	std::thread				rotateThread;
+	std::condition_variable	rotateSignal;
+	bool					rotating;
+	std::string				rotatePath;
+	float					rotateSeconds;
+	unsigned int			rotateFiles;
+	unsigned int			rotateNext;
+
+	State() : threads(0), start(Profiler::now()), rotating(false), rotateSeconds(0), rotateFiles(0), rotateNext(0) {}
+	~State() {
+		Profiler::stopRotating();
+		for (Ring* ring : rings)
+			delete ring;
+	}
+};
+
+State state;
+thread_local RingOwner owner = { nullptr };
+
+RingOwner::~RingOwner() {
+	if (ring == nullptr)
+		return;
+	std::lock_guard<std::mutex> lock(state.mutex);
+	ring->owned = false;
+}
+
+Ring& threadRing() {
+	if (owner.ring != nullptr)
+		return *owner.ring;
+
+	std::lock_guard<std::mutex> lock(state.mutex);
+	Ring* ring = nullptr;
+	for (Ring* free : state.rings) {
+		if (free->owned == false) {
+			ring = free;
+			break;
+		}
+	}
+	if (ring == nullptr) {
+		ring = new Ring();
+		state.rings.push_back(ring);
+	}
+
+	// a reused ring keeps the last thread's zones, so both share a row in the trace
+	if (ring->thread == 0)
+		ring->thread = ++state.threads;
+	ring->name.clear();
+	ring->owned = true;
+	owner.ring = ring;
+	return *ring;
+}
+
+void writeString(FILE* file, const char* text) {
+	fputc('"', file);
+	for (; *text != 0; ++text) {
+		if (*text == '"' || *text == '\\')
+			fputc('\\', file);
+		if ((unsigned char)*text >= 0x20)
+			fputc(*text, file);
+	}
+	fputc('"', file);
+}
+
+// writes the ring's events from index first on, returns where it got up to, needs state.mutex
+unsigned long long writeRing(FILE* file, Ring& ring, unsigned long long first, bool& comma) {
+	unsigned long long written = ring.written.load();
+	if (written > first + Profiler::RING_EVENTS)
+		first = written - Profiler::RING_EVENTS;
+
+	std::vector<Event> events;
+	events.reserve((size_t)(written - first));
+	for (unsigned long long i = first; i < written; ++i) {
+		const RingEvent& source = ring.events[i % Profiler::RING_EVENTS];
+		Event event = {
+			source.name.load(std::memory_order_relaxed),
+			source.start.load(std::memory_order_relaxed),
+			source.end.load(std::memory_order_relaxed)
+		};
+		events.push_back(event);
+	}
+
+	// the thread kept recording while they were copied, the oldest may have been overwritten
+	std::atomic_thread_fence(std::memory_order_acquire);
+	unsigned long long after = ring.written.load();
+	size_t skip = after > first + Profiler::RING_EVENTS ? (size_t)(after - Profiler::RING_EVENTS - first) : 0;
+
+	for (size_t i = skip; i < events.size(); ++i) {
+		const Event& event = events[i];
+		fprintf(file, "%s\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":", comma ? "," : "",
+				ring.thread, (event.start - state.start) / 1000.0, (event.end - event.start) / 1000.0);
+		writeString(file, event.name);
+		fputc('}', file);
+		comma = true;
+	}
+	return written;
+}
+
+// every ring from its own starting point, needs state.mutex
+bool writeFile(const char* path, bool rotate) {
+	FILE* file = fopen(path, "w");
+	if (file == nullptr)
+		return false;
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+	bool comma = false;
+	for (Ring* ring : state.rings) {
+		if (ring->name.empty() == false) {
+			fprintf(file, "%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", comma ? "," : "", ring->thread);
+			writeString(file, ring->name.c_str());
+			fputs("}}", file);
+			comma = true;
+		}
+		unsigned long long written = writeRing(file, *ring, rotate ? ring->rotated : 0, comma);
+		if (rotate)
+			ring->rotated = written;
+	}
+	fputs("\n]}\n", file);
+	fclose(file);
+	return true;
+}
+
+void rotateLoop() {
+	std::unique_lock<std::mutex> lock(state.mutex);
+	while (state.rotating) {
+		state.rotateSignal.wait_for(lock, std::chrono::microseconds((long long)(state.rotateSeconds * 1000000)));
+
+		char path[512];
+		snprintf(path, sizeof(path), "%s.%u.json", state.rotatePath.c_str(), state.rotateNext);
+		state.rotateNext = (state.rotateNext + 1) % state.rotateFiles;
+		if (writeFile(path, true) == false)
+			printf("Profiler: failed to write %s\n", path);
+	}
+}
+
+}
+
+long long Profiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::record(const char* a_name, long long a_start, long long a_end) {
+	Ring& ring = threadRing();
+	unsigned long long index = ring.written.load(std::memory_order_relaxed);
+	RingEvent& event = ring.events[index % RING_EVENTS];
+	event.name.store(a_name, std::memory_order_relaxed);
+	event.start.store(a_start, std::memory_order_relaxed);
+	event.end.store(a_end, std::memory_order_relaxed);
+
+	// publishes the event to anything reading the ring
+	ring.written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::setThreadName(const char* a_name) {
+	Ring& ring = threadRing();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	ring.name = a_name;
+}
+
+bool Profiler::writeTrace(const char* a_path) {
+	std::lock_guard<std::mutex> lock(state.mutex);
+	return writeFile(a_path, false);
+}
+
+void Profiler::startRotating(const char* a_path, float a_seconds, unsigned int a_files) {
+	stopRotating();
+
+	std::lock_guard<std::mutex> lock(state.mutex);
+	state.rotating = true;
+	state.rotatePath = a_path;
+	state.rotateSeconds = a_seconds > 0 ? a_seconds : 1;
+	state.rotateFiles = a_files > 0 ? a_files : 1;
+	state.rotateNext = 0;
+
+	// only zones from here on go in the first file
+	for (Ring* ring : state.rings)
+		ring->rotated = ring->written.load();
+
+	state.rotateThread = std::thread(rotateLoop);
+}
+
+void Profiler::stopRotating() {
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if (state.rotating == false)
+			return;
+		state.rotating = false;
+	}
+	state.rotateSignal.notify_all();
+	state.rotateThread.join();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+
+// times the rest of the enclosing block as one zone, a_name has to outlive the profiler so is
+// normally a string literal, define PROFILER_DISABLED to compile every zone out entirely
+#ifdef PROFILER_DISABLED
+#define PROFILE_SCOPE(a_name)
+#else
+#define PROFILE_CONCAT_INNER(a_left, a_right)	a_left##a_right
+#define PROFILE_CONCAT(a_left, a_right)			PROFILE_CONCAT_INNER(a_left, a_right)
+#define PROFILE_SCOPE(a_name)					ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(a_name)
+#endif
+
+// scoped zones recorded into a fixed ring per thread, so recording never locks or allocates and
+// the newest RING_EVENTS zones of each thread are always there to write out as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev), while disabled a zone costs one load and a branch
+class Profiler {
+public:
+
+	static const unsigned int RING_EVENTS = 65536;
+
+	// off until enabled
+	static void		setEnabled(bool a_enabled)	{ sm_enabled = a_enabled; }
+	static bool		isEnabled()					{ return sm_enabled.load(); }
+
+	// shown for the calling thread in the trace
+	static void		setThreadName(const char* a_name);
+
+	// writes every zone still in the rings as trace_event JSON, false if the file can't be opened
+	static bool		writeTrace(const char* a_path);
+
+	// writes the zones recorded since the last file every a_seconds from a thread of its own,
+	// cycling through a_path.0.json to a_path.<a_files - 1>.json so it can be left running
+	static void		startRotating(const char* a_path, float a_seconds, unsigned int a_files);
+	static void		stopRotating();
+
+	// nanoseconds on a steady clock
+	static long long	now();
+
+	// a zone on the calling thread
+	static void		record(const char* a_name, long long a_start, long long a_end);
+
+private:
+
+	static std::atomic<bool>	sm_enabled;
+};
+
+class ProfileScope {
+public:
+
+	explicit ProfileScope(const char* a_name)
+		: m_name(a_name),
+		m_start(Profiler::isEnabled() ? Profiler::now() : 0) {
+	}
+
+	~ProfileScope() {
+		if (m_start != 0)
+			Profiler::record(m_name, m_start, Profiler::now());
+	}
+
+private:
+
+	ProfileScope(const ProfileScope&);
+	ProfileScope& operator=(const ProfileScope&);
+
+	const char*	m_name;
+	long long	m_start;
+};
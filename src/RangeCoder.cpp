@@ -0,0 +1,172 @@
+#include "RangeCoder.h"
+
+static const unsigned int RANGE_TOP = 1 << 24;
+static const unsigned int RANGE_MOVE_BITS = 5;
+
+void RangeIntegerModel::reset() {
+	for (auto& prob : lengthProbs)
+		prob = RANGE_PROBABILITY_INIT;
+	for (auto& prob : mantissaProbs)
+		prob = RANGE_PROBABILITY_INIT;
+}
+
+// returns the number of significant bits in value, 0 for 0
+static unsigned int bitLength(unsigned int value) {
+	unsigned int length = 0;
+	while (value != 0) {
+		++length;
+		value >>= 1;
+	}
+	return length;
+}
+
+RangeEncoder::RangeEncoder(std::vector<unsigned char>& output)
+	: m_output(output),
+	m_low(0),
+	m_range(0xffffffff),
+	m_cache(0),
+	m_cacheSize(1) {
+}
+
+void RangeEncoder::encodeBit(unsigned short& prob, unsigned int bit) {
+	unsigned int bound = (m_range >> RANGE_PROBABILITY_BITS) * prob;
+	if (bit == 0) {
+		m_range = bound;
+		prob += ((1 << RANGE_PROBABILITY_BITS) - prob) >> RANGE_MOVE_BITS;
+	}
+	else {
+		m_low += bound;
+		m_range -= bound;
+		prob -= prob >> RANGE_MOVE_BITS;
+	}
+	while (m_range < RANGE_TOP) {
+		m_range <<= 8;
+		shiftLow();
+	}
+}
+
+void RangeEncoder::encodeDirect(unsigned int value, unsigned int bitCount) {
+	while (bitCount-- > 0) {
+		m_range >>= 1;
+		if ((value >> bitCount) & 1)
+			m_low += m_range;
+		while (m_range < RANGE_TOP) {
+			m_range <<= 8;
+			shiftLow();
+		}
+	}
+}
+
+void RangeEncoder::encodeInteger(RangeIntegerModel& model, unsigned int value) {
+	// bit length as a 6 bit tree
+	unsigned int length = bitLength(value);
+	unsigned int node = 1;
+	for (int i = 5; i >= 0; --i) {
+		unsigned int bit = (length >> i) & 1;
+		encodeBit(model.lengthProbs[node], bit);
+		node = (node << 1) | bit;
+	}
+
+	// the leading one is implied by the length
+	if (length > 1) {
+		encodeBit(model.mantissaProbs[length], (value >> (length - 2)) & 1);
+		encodeDirect(value, length - 2);
+	}
+}
+
+void RangeEncoder::flush() {
+	for (int i = 0; i < 5; ++i)
+		shiftLow();
+}
+
+void RangeEncoder::shiftLow() {
+	if ((unsigned int)m_low < 0xff000000 || (m_low >> 32) != 0) {
+		unsigned char carry = (unsigned char)(m_low >> 32);
+		unsigned char temp = m_cache;
+		do {
+			m_output.push_back((unsigned char)(temp + carry));
+			temp = 0xff;
+		} while (--m_cacheSize != 0);
+		m_cache = (unsigned char)(m_low >> 24);
+	}
+	++m_cacheSize;
+	m_low = (m_low & 0x00ffffff) << 8;
+}
+
+RangeDecoder::RangeDecoder(const unsigned char* data, unsigned int size)
+	: m_data(data),
+	m_size(size),
+	m_position(0),
+	m_code(0),
+	m_range(0xffffffff),
+	m_overrun(false) {
+	for (int i = 0; i < 5; ++i)
+		m_code = (m_code << 8) | nextByte();
+}
+
+unsigned int RangeDecoder::decodeBit(unsigned short& prob) {
+	unsigned int bit = 0;
+	unsigned int bound = (m_range >> RANGE_PROBABILITY_BITS) * prob;
+	if (m_code < bound) {
+		m_range = bound;
+		prob += ((1 << RANGE_PROBABILITY_BITS) - prob) >> RANGE_MOVE_BITS;
+	}
+	else {
+		m_code -= bound;
+		m_range -= bound;
+		prob -= prob >> RANGE_MOVE_BITS;
+		bit = 1;
+	}
+	while (m_range < RANGE_TOP) {
+		m_range <<= 8;
+		m_code = (m_code << 8) | nextByte();
+	}
+	return bit;
+}
+
+unsigned int RangeDecoder::decodeDirect(unsigned int bitCount) {
+	unsigned int value = 0;
+	while (bitCount-- > 0) {
+		m_range >>= 1;
+		unsigned int bit = 0;
+		if (m_code >= m_range) {
+			m_code -= m_range;
+			bit = 1;
+		}
+		value = (value << 1) | bit;
+		while (m_range < RANGE_TOP) {
+			m_range <<= 8;
+			m_code = (m_code << 8) | nextByte();
+		}
+	}
+	return value;
+}
+
+unsigned int RangeDecoder::decodeInteger(RangeIntegerModel& model) {
+	unsigned int node = 1;
+	for (int i = 0; i < 6; ++i)
+		node = (node << 1) | decodeBit(model.lengthProbs[node]);
+	unsigned int length = node - 64;
+
+	if (length == 0)
+		return 0;
+	// corrupt data, a 32 bit value has at most 32 bits
+	if (length > 32) {
+		m_overrun = true;
+		return 0;
+	}
+
+	unsigned int value = 1;
+	if (length > 1) {
+		value = (value << 1) | decodeBit(model.mantissaProbs[length]);
+		value = (value << (length - 2)) | decodeDirect(length - 2);
+	}
+	return value;
+}
+
+unsigned char RangeDecoder::nextByte() {
+	if (m_position < m_size)
+		return m_data[m_position++];
+	m_overrun = true;
+	return 0;
+}
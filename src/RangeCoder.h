@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+// adaptive binary range coder (in the style of LZMA's) used as the entropy stage
+// for snapshot residuals, probabilities are 11 bit and adapt by 1/32 per coded bit
+static const unsigned int RANGE_PROBABILITY_BITS = 11;
+static const unsigned short RANGE_PROBABILITY_INIT = 1 << (RANGE_PROBABILITY_BITS - 1);
+
+// model for an unsigned integer, coded as its bit length followed by its
+// mantissa, with the bit below the leading one also modelled
+struct RangeIntegerModel {
+	unsigned short	lengthProbs[64];
+	unsigned short	mantissaProbs[33];
+
+	void reset();
+};
+
+class RangeEncoder {
+public:
+
+	RangeEncoder(std::vector<unsigned char>& output);
+
+	void	encodeBit(unsigned short& prob, unsigned int bit);
+	void	encodeDirect(unsigned int value, unsigned int bitCount);
+	void	encodeInteger(RangeIntegerModel& model, unsigned int value);
+
+	// must be called once everything has been encoded
+	void	flush();
+
+private:
+
+	void	shiftLow();
+
+	std::vector<unsigned char>&	m_output;
+	unsigned long long			m_low;
+	unsigned int				m_range;
+	unsigned char				m_cache;
+	unsigned long long			m_cacheSize;
+};
+
+class RangeDecoder {
+public:
+
+	RangeDecoder(const unsigned char* data, unsigned int size);
+
+	unsigned int	decodeBit(unsigned short& prob);
+	unsigned int	decodeDirect(unsigned int bitCount);
+	unsigned int	decodeInteger(RangeIntegerModel& model);
+
+	// true if decoding tried to read past the end of the data
+	bool			overrun() const		{ return m_overrun; }
+
+private:
+
+	unsigned char	nextByte();
+
+	const unsigned char*	m_data;
+	unsigned int			m_size;
+	unsigned int			m_position;
+	unsigned int			m_code;
+	unsigned int			m_range;
+	bool					m_overrun;
+};
@@ -0,0 +1,170 @@
+#include "RenderState.h"
+#include "gl_core_4_4.h"
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+const unsigned int capabilityEnums[RenderState::CAPABILITY_COUNT] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE };
+
+// filled in by RenderState::reset
+struct Shadow {
+	unsigned int	program;
+	unsigned int	vao;
+	unsigned int	vbo;
+	bool			enabled[RenderState::CAPABILITY_COUNT];
+	unsigned int	blendSrc;
+	unsigned int	blendDst;
+	bool			depthMask;
+
+	std::unordered_map<unsigned int, std::unordered_map<std::string, int>>	uniforms;
+
+	unsigned int	saved;
+	unsigned int	savedLastFrame;
+};
+
+Shadow state;
+
+}
+
+void RenderState::reset() {
+	int value = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+	state.program = value;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+	state.vao = value;
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &value);
+	state.vbo = value;
+
+	for (int i = 0; i < CAPABILITY_COUNT; ++i)
+		state.enabled[i] = glIsEnabled(capabilityEnums[i]) == GL_TRUE;
+
+	glGetIntegerv(GL_BLEND_SRC, &value);
+	state.blendSrc = value;
+	glGetIntegerv(GL_BLEND_DST, &value);
+	state.blendDst = value;
+
+	GLboolean depthMask = GL_TRUE;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+	state.depthMask = depthMask == GL_TRUE;
+
+	state.uniforms.clear();
+	state.saved = state.savedLastFrame = 0;
+}
+
+void RenderState::useProgram(unsigned int a_program) {
+	if (state.program == a_program) {
+		++state.saved;
+		return;
+	}
+	glUseProgram(a_program);
+	state.program = a_program;
+}
+
+void RenderState::bindVertexArray(unsigned int a_vao) {
+	if (state.vao == a_vao) {
+		++state.saved;
+		return;
+	}
+	glBindVertexArray(a_vao);
+	state.vao = a_vao;
+}
+
+void RenderState::bindArrayBuffer(unsigned int a_vbo) {
+	if (state.vbo == a_vbo) {
+		++state.saved;
+		return;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, a_vbo);
+	state.vbo = a_vbo;
+}
+
+void RenderState::setEnabled(Capability a_capability, bool a_enabled) {
+	if (state.enabled[a_capability] == a_enabled) {
+		++state.saved;
+		return;
+	}
+	if (a_enabled)
+		glEnable(capabilityEnums[a_capability]);
+	else
+		glDisable(capabilityEnums[a_capability]);
+	state.enabled[a_capability] = a_enabled;
+}
+
+bool RenderState::isEnabled(Capability a_capability) {
+	return state.enabled[a_capability];
+}
+
+void RenderState::setBlendFunc(unsigned int a_src, unsigned int a_dst) {
+	if (state.blendSrc == a_src && state.blendDst == a_dst) {
+		++state.saved;
+		return;
+	}
+	glBlendFunc(a_src, a_dst);
+	state.blendSrc = a_src;
+	state.blendDst = a_dst;
+}
+
+void RenderState::getBlendFunc(unsigned int& a_src, unsigned int& a_dst) {
+	a_src = state.blendSrc;
+	a_dst = state.blendDst;
+}
+
+void RenderState::setDepthMask(bool a_write) {
+	if (state.depthMask == a_write) {
+		++state.saved;
+		return;
+	}
+	glDepthMask(a_write ? GL_TRUE : GL_FALSE);
+	state.depthMask = a_write;
+}
+
+bool RenderState::getDepthMask() {
+	return state.depthMask;
+}
+
+int RenderState::uniformLocation(unsigned int a_program, const char* a_name) {
+	auto& uniforms = state.uniforms[a_program];
+	auto iter = uniforms.find(a_name);
+	if (iter != uniforms.end()) {
+		++state.saved;
+		return iter->second;
+	}
+	int location = glGetUniformLocation(a_program, a_name);
+	uniforms[a_name] = location;
+	return location;
+}
+
+void RenderState::deleteProgram(unsigned int a_program) {
+	// a program in use would only be deleted once it stops being used, and its name
+	// could be handed out again in the meantime, so stop using it first
+	if (state.program == a_program)
+		useProgram(0);
+	glDeleteProgram(a_program);
+	state.uniforms.erase(a_program);
+}
+
+void RenderState::deleteVertexArray(unsigned int a_vao) {
+	glDeleteVertexArrays(1, &a_vao);
+	if (state.vao == a_vao)
+		state.vao = 0;
+}
+
+void RenderState::deleteBuffer(unsigned int a_vbo) {
+	glDeleteBuffers(1, &a_vbo);
+	if (state.vbo == a_vbo)
+		state.vbo = 0;
+}
+
+void RenderState::endFrame() {
+	state.savedLastFrame = state.saved;
+	state.saved = 0;
+}
+
+unsigned int RenderState::savedCalls() {
+	return state.saved;
+}
+
+unsigned int RenderState::savedCallsLastFrame() {
+	return state.savedLastFrame;
+}
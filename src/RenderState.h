@@ -0,0 +1,46 @@
+#pragma once
+
+// shadows the bits of GL state the renderers touch, so they never have to query the driver
+// and redundant changes are skipped, everything that draws goes through here once created
+// only valid on the thread the context is current on
+class RenderState {
+public:
+
+	enum Capability {
+		BLEND,
+		DEPTH_TEST,
+		CULL_FACE,
+		CAPABILITY_COUNT,
+	};
+
+	// reads the actual GL state, call once the context is current
+	static void		reset();
+
+	static void		useProgram(unsigned int a_program);
+	static void		bindVertexArray(unsigned int a_vao);
+	static void		bindArrayBuffer(unsigned int a_vbo);
+
+	static void		setEnabled(Capability a_capability, bool a_enabled);
+	static bool		isEnabled(Capability a_capability);
+
+	static void		setBlendFunc(unsigned int a_src, unsigned int a_dst);
+	static void		getBlendFunc(unsigned int& a_src, unsigned int& a_dst);
+
+	static void		setDepthMask(bool a_write);
+	static bool		getDepthMask();
+
+	// cached glGetUniformLocation, for create, draw paths keep what it returns in members rather than
+	// hashing the name every frame
+	static int		uniformLocation(unsigned int a_program, const char* a_name);
+
+	// delete through these so the shadowed bindings and uniform cache don't go stale
+	static void		deleteProgram(unsigned int a_program);
+	static void		deleteVertexArray(unsigned int a_vao);
+	static void		deleteBuffer(unsigned int a_vbo);
+
+	// GL calls skipped as redundant or served from the cache, the per frame count
+	// is rolled over by endFrame, which BaseApplication calls after every swap
+	static void			endFrame();
+	static unsigned int	savedCalls();
+	static unsigned int	savedCallsLastFrame();
+};
@@ -1,10 +1,20 @@
 #include "Server.h"
+#include "Profiler.h"
 #include <RakNetTypes.h>
+#include <GetTime.h>
 #include <Windows.h>
 #include <chrono>
+#include <cstring>
 
-Server::Server(unsigned int entityCount, float arenaRadius, float packetlossPercentage, float delayPercentage, float delayRange)
+Server::Server(unsigned int entityCount, float arenaRadius, float packetlossPercentage, float delayPercentage, float delayRange,
+			   bool coSimulate, unsigned int seed, bool residuals, bool rangeCoding, float churnRate)
 	: m_arenaRadius(arenaRadius),
+	m_coSimulate(coSimulate),
+	m_seed(seed),
+	m_residuals(residuals),
+	m_rangeCoding(rangeCoding),
+	m_churnRate(churnRate),
+	m_churnAccumulator(0),
 	m_packetlossPercentage(packetlossPercentage),
 	m_delayPercentage(delayPercentage),
 	m_delayRange(delayRange)
@@ -12,10 +22,11 @@ Server::Server(unsigned int entityCount, float arenaRadius, float packetlossPerc
 	// initialize the Raknet peer interface first
 	m_peerInterface = RakNet::RakPeerInterface::GetInstance();
 
-	setupAIEntities(entityCount);
-	
 	//Set number of sent messages to 0
 	m_numMessagesSent = 0;
+	m_tickTime = 0;
+
+	setupAIEntities(entityCount);
 }
 
 Server::~Server() {
@@ -36,6 +47,9 @@ void Server::run() {
 	// startup the server, and start it listening to clients
 	std::cout << "Starting up the server..." << std::endl;
 	std::cout << "Press ESCAPE to close the server..." << std::endl;
+	if (Profiler::isEnabled())
+		std::cout << "Press F9 to write the profile to server_trace.json..." << std::endl;
+	Profiler::setThreadName("server");
 
 	// create a socket descriptor to describe this connection
 	RakNet::SocketDescriptor sd(SERVER_PORT, 0);
@@ -58,7 +72,7 @@ void Server::run() {
 		microsecondCounter += deltaMicroseconds;
 		// if 16666 microseconds have passed then update and broadcast entities
 		while (microsecondCounter > 16666) {
-			updateAIEntities(0.016666667f);
+			updateAIEntities(SIMULATION_TIMESTEP);
 			microsecondCounter -= 16666;
 		}
 		previousTime = time;
@@ -67,7 +81,7 @@ void Server::run() {
 		for (auto iter = m_delayedMessages.begin(); iter != m_delayedMessages.end(); ) {
 			(*iter)->delayMicroseconds -= deltaMicroseconds;
 			if ((*iter)->delayMicroseconds <= 0) {
-				sendBitStream(&(*iter)->stream);
+				sendBitStream(&(*iter)->stream, (*iter)->address);
 				delete (*iter);
 				iter = m_delayedMessages.erase(iter);
 			}
@@ -75,7 +89,13 @@ void Server::run() {
 				++iter;
 		}
 
-		// handle received messages
+		if (Profiler::isEnabled() && (GetAsyncKeyState(VK_F9) & 1)) {
+			if (Profiler::writeTrace("server_trace.json"))
+				std::cout << "Wrote the profile to server_trace.json" << std::endl;
+		}
+
+		// handle received messages, the zone runs to the end of the loop
+		PROFILE_SCOPE("receive");
 		for ( packet = m_peerInterface->Receive();
 			  packet;
 			  m_peerInterface->DeallocatePacket(packet), packet = m_peerInterface->Receive()) {
@@ -83,14 +103,55 @@ void Server::run() {
 			switch (packet->data[0]) {
 			case ID_NEW_INCOMING_CONNECTION: {
 				std::cout << "A connection is incoming.\n";
+				ClientConnection& client = m_clients[packet->guid.g];
+				client.address = packet->systemAddress;
+				client.ackedTick = SNAPSHOT_NO_BASELINE;
+				client.capabilities = 0;
+				if (m_coSimulate)
+					sendSimulationState(packet->systemAddress);
+				else
+					sendAllEntities(packet->systemAddress);
 				break;
 			}
+			case ID_SIMULATION_RESYNC:
+				std::cout << "A client requested a resync.\n";
+				if (m_coSimulate)
+					sendSimulationState(packet->systemAddress);
+				break;
 			case ID_DISCONNECTION_NOTIFICATION:
 				std::cout << "A client has disconnected.\n";
+				m_clients.erase(packet->guid.g);
 				break;
 			case ID_CONNECTION_LOST:
 				std::cout << "A client lost the connection.\n";
+				m_clients.erase(packet->guid.g);
+				break;
+			case ID_CLIENT_CAPABILITIES: {
+				auto iter = m_clients.find(packet->guid.g);
+				if (iter == m_clients.end())
+					break;
+				RakNet::BitStream stream(packet->data, packet->length, false);
+				stream.IgnoreBytes(sizeof(RakNet::MessageID));
+				stream.Read(iter->second.capabilities);
+				// the format may change, so don't code against anything sent before
+				iter->second.ackedTick = SNAPSHOT_NO_BASELINE;
 				break;
+			}
+			case ID_SNAPSHOT_ACK: {
+				auto iter = m_clients.find(packet->guid.g);
+				if (iter == m_clients.end())
+					break;
+				RakNet::BitStream stream(packet->data, packet->length, false);
+				stream.IgnoreBytes(sizeof(RakNet::MessageID));
+				unsigned int tick = SNAPSHOT_NO_BASELINE;
+				stream.Read(tick);
+				// acks can arrive out of order, only ever move the baseline forward
+				if (tick == SNAPSHOT_NO_BASELINE ||
+					iter->second.ackedTick == SNAPSHOT_NO_BASELINE ||
+					tick > iter->second.ackedTick)
+					iter->second.ackedTick = tick;
+				break;
+			}
 			default:
 				std::cout << "Received a message with a unknown id: " << packet->data[0];
 				break;
@@ -102,7 +163,8 @@ void Server::run() {
 	}
 }
 
-void Server::broadcastFaultyData(const char* data, unsigned int size) {
+void Server::broadcastFaultyData(RakNet::BitStream& stream, const RakNet::SystemAddress& address) {
+	PROFILE_SCOPE("broadcastFaultyData");
 
 	// lose messages every so often
 	if (randf() * 100 < m_packetlossPercentage)
@@ -111,20 +173,15 @@ void Server::broadcastFaultyData(const char* data, unsigned int size) {
 	// delay messages every so often
 	if (randf() * 100 < m_delayPercentage) {
 		DelayedBroadcast* b = new DelayedBroadcast;
-		b->stream.Write((RakNet::MessageID)GameMessages::ID_ENTITY_LIST);
-		b->stream.Write(size);
-		b->stream.Write(data, size);
+		b->address = address;
+		b->stream.Write(stream);
 		float delay = randf() * m_delayRange;
 		b->delayMicroseconds = (double)(delay * 1000.0 * 1000.0);
 		m_delayedMessages.push_back(b);
 	}
 	else {
 		// just send the stream
-		RakNet::BitStream stream;
-		stream.Write((RakNet::MessageID)GameMessages::ID_ENTITY_LIST);
-		stream.Write(size);
-		stream.Write(data, size);
-		sendBitStream(&stream);
+		sendBitStream(&stream, address);
 	}
 }
 
@@ -132,96 +189,365 @@ float Server::randf() {
 	return rand() / (float)RAND_MAX;
 }
 
-void Server::sendBitStream(RakNet::BitStream* stream) {
-	m_peerInterface->Send(stream, HIGH_PRIORITY, UNRELIABLE, 0, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
+void Server::sendBitStream(RakNet::BitStream* stream, const RakNet::SystemAddress& address) {
+	bool broadcast = address == RakNet::UNASSIGNED_SYSTEM_ADDRESS;
+	m_peerInterface->Send(stream, HIGH_PRIORITY, UNRELIABLE, 0, address, broadcast);
+}
+
+void Server::broadcastSnapshots() {
+	PROFILE_SCOPE("broadcastSnapshots");
+	QuantizedSnapshot& current = m_snapshotHistory.store(m_numMessagesSent);
+	SnapshotCodec::quantize(m_aiEntities.data(), m_aiEntities.size(), m_numMessagesSent, m_tickTime, current);
+
+	for (auto& pair : m_clients) {
+		ClientConnection& client = pair.second;
+		RakNet::BitStream stream;
+
+		// clients that can't decode residuals still get the raw list
+		if ((client.capabilities & CAPABILITY_RESIDUALS) == 0) {
+			writeEntityList(stream, m_aiEntities.data(), m_aiEntities.size(), m_tickTime);
+			broadcastFaultyData(stream, client.address);
+			continue;
+		}
+
+		// falls back to absolute values if the acknowledged snapshot is too old
+		const QuantizedSnapshot* baseline = nullptr;
+		if (client.ackedTick != SNAPSHOT_NO_BASELINE)
+			baseline = m_snapshotHistory.find(client.ackedTick);
+
+		if (m_rangeCoding && (client.capabilities & CAPABILITY_RANGE_CODING) != 0)
+			SnapshotCodec::writeRangeResiduals(stream, current, baseline);
+		else
+			SnapshotCodec::writeResiduals(stream, current, baseline);
+		broadcastFaultyData(stream, client.address);
+	}
+}
+
+static bool sameEntities(const QuantizedSnapshot& a, const QuantizedSnapshot& b) {
+	if (a.entities.size() != b.entities.size())
+		return false;
+	for (size_t i = 0; i < a.entities.size(); ++i) {
+		const QuantizedEntity& x = a.entities[i];
+		const QuantizedEntity& y = b.entities[i];
+		if (x.id != y.id || x.px != y.px || x.py != y.py ||
+			x.vx != y.vx || x.vy != y.vy || x.teleported != y.teleported)
+			return false;
+	}
+	return true;
+}
+
+void Server::benchmarkCodecs(unsigned int ticks) {
+
+	// clients ack a few ticks late, so code against a baseline that far back
+	const unsigned int BASELINE_LAG = 3;
+
+	enum { RAW, VARINT, RANGE, FORMAT_COUNT };
+	const char* names[FORMAT_COUNT] = { "raw", "residual varint", "residual range" };
+	double encodeNanoseconds[FORMAT_COUNT] = { 0 };
+	double decodeNanoseconds[FORMAT_COUNT] = { 0 };
+	double bytes[FORMAT_COUNT] = { 0 };
+
+	std::vector<AIEntity> decoded;
+	RakNet::Time decodedTime = 0;
+	QuantizedSnapshot decodedSnapshot;
+	unsigned int mismatches = 0;
+
+	for (unsigned int tick = 1; tick <= ticks; ++tick) {
+		m_numMessagesSent = tick;
+		m_tickTime = RakNet::GetTime();
+		for (auto& ai : m_aiServerEntities) {
+			updateWander(ai, m_arenaRadius, SIMULATION_TIMESTEP);
+			ai.data->ticks = tick;
+		}
+
+		QuantizedSnapshot& current = m_snapshotHistory.store(tick);
+		SnapshotCodec::quantize(m_aiEntities.data(), m_aiEntities.size(), tick, m_tickTime, current);
+		const QuantizedSnapshot* baseline = tick > BASELINE_LAG ? m_snapshotHistory.find(tick - BASELINE_LAG) : nullptr;
+
+		for (int format = 0; format < FORMAT_COUNT; ++format) {
+			RakNet::BitStream stream;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			if (format == RAW)
+				writeEntityList(stream, m_aiEntities.data(), m_aiEntities.size(), m_tickTime);
+			else if (format == VARINT)
+				SnapshotCodec::writeResiduals(stream, current, baseline);
+			else
+				SnapshotCodec::writeRangeResiduals(stream, current, baseline);
+			auto encoded = std::chrono::high_resolution_clock::now();
+
+			// the server's history holds exactly what a client would have reconstructed
+			stream.IgnoreBytes(sizeof(RakNet::MessageID));
+			bool ok = true;
+			EntityListView view;
+			if (format == RAW)
+				ok = view.parse(stream.GetData(), stream.GetNumberOfBytesUsed(), decoded, decodedTime);
+			else if (format == VARINT)
+				ok = SnapshotCodec::readResiduals(stream, m_snapshotHistory, decodedSnapshot);
+			else
+				ok = SnapshotCodec::readRangeResiduals(stream, m_snapshotHistory, decodedSnapshot);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			// the client reads raw lists in place, so they're checked against the entities after timing
+			if (ok && format == RAW)
+				ok = view.size() == m_aiEntities.size() && decodedTime == m_tickTime &&
+					std::memcmp(view.data(), m_aiEntities.data(), view.size() * sizeof(AIEntity)) == 0;
+			else if (ok)
+				ok = sameEntities(current, decodedSnapshot);
+			if (ok == false)
+				++mismatches;
+
+			encodeNanoseconds[format] += std::chrono::duration_cast<std::chrono::nanoseconds>(encoded - start).count();
+			decodeNanoseconds[format] += std::chrono::duration_cast<std::chrono::nanoseconds>(end - encoded).count();
+			bytes[format] += stream.GetNumberOfBytesUsed();
+		}
+	}
+
+	// ids are coded as the delta from the one before, which takes all 32 bits once churn has pushed
+	// generations up, so the last tick is round tripped again with the highest generations there are
+	unsigned int highGenerationMismatches = 0;
+	if (const QuantizedSnapshot* last = m_snapshotHistory.find(ticks)) {
+		QuantizedSnapshot high = *last;
+		unsigned int maxGeneration = 0xffffffff >> SLOT_INDEX_BITS;
+		for (size_t i = 0; i < high.entities.size(); ++i) {
+			QuantizedEntity& q = high.entities[i];
+			q.id = ((maxGeneration - (unsigned int)(i % 4) * 1000) << SLOT_INDEX_BITS) | slotIndex(q.id);
+			q.teleported = i % 2 == 0;
+		}
+
+		for (int format = VARINT; format < FORMAT_COUNT; ++format) {
+			RakNet::BitStream stream;
+			if (format == VARINT)
+				SnapshotCodec::writeResiduals(stream, high, nullptr);
+			else
+				SnapshotCodec::writeRangeResiduals(stream, high, nullptr);
+
+			stream.IgnoreBytes(sizeof(RakNet::MessageID));
+			bool ok = format == VARINT ?
+				SnapshotCodec::readResiduals(stream, m_snapshotHistory, decodedSnapshot) :
+				SnapshotCodec::readRangeResiduals(stream, m_snapshotHistory, decodedSnapshot);
+			if (ok == false || sameEntities(high, decodedSnapshot) == false)
+				++highGenerationMismatches;
+		}
+	}
+
+	double entityTicks = (double)ticks * m_aiEntities.size();
+	std::cout << "Codec benchmark, " << m_aiEntities.size() << " entities over " << ticks << " ticks" << std::endl;
+	for (int format = 0; format < FORMAT_COUNT; ++format) {
+		std::cout << names[format] << ": "
+			<< encodeNanoseconds[format] / entityTicks << " ns/entity encode, "
+			<< decodeNanoseconds[format] / entityTicks << " ns/entity decode, "
+			<< bytes[format] / entityTicks << " bytes/entity" << std::endl;
+	}
+	if (mismatches > 0)
+		std::cout << "WARNING: " << mismatches << " snapshots did not decode to the encoded state" << std::endl;
+	if (highGenerationMismatches > 0)
+		std::cout << "WARNING: " << highGenerationMismatches << " formats did not decode ids with high generations" << std::endl;
+}
+
+void Server::sendSimulationState(const RakNet::SystemAddress& address) {
+	RakNet::BitStream stream;
+	stream.Write((RakNet::MessageID)GameMessages::ID_SIMULATION_STATE);
+	stream.Write(m_numMessagesSent);
+	stream.Write(m_arenaRadius);
+	stream.Write((unsigned int)m_aiServerEntities.size());
+	for (auto& ai : m_aiServerEntities) {
+		stream.Write((const char*)ai.data, sizeof(AIEntity));
+		stream.Write(ai.wanderAngle);
+		stream.Write(ai.rngState);
+	}
+
+	// corrections must arrive, so they bypass the faulty broadcast
+	m_peerInterface->Send(&stream, HIGH_PRIORITY, RELIABLE_ORDERED, 0, address, false);
 }
 
 void Server::setupAIEntities(unsigned int count) {
-	unsigned int nextId = 0;
-	m_aiEntities.resize(count);
-	m_aiServerEntities.resize(count);
-	for (auto& ai : m_aiEntities) {
-		// random position and facing
-		float facing = randf() * 3.14159f * 2;
-		float offsetDir = randf() * 3.14159f * 2;
-		float offset = m_arenaRadius * randf();
+	// churn despawns before it spawns, so the count never grows past this
+	m_aiEntities.reserve(count);
+	m_aiServerEntities.reserve(count);
+	for (unsigned int i = 0; i < count; ++i)
+		spawnAIEntity();
+
+	// nobody is connected yet to be told about these
+	m_spawned.clear();
+}
+
+bool Server::spawnAIEntity() {
+	// random position and facing
+	float facing = randf() * 3.14159f * 2;
+	float offsetDir = randf() * 3.14159f * 2;
+	float offset = m_arenaRadius * randf();
+
+	AIEntity ai;
+	ai.position.x = sinf(offsetDir) * offset;
+	ai.position.y = cosf(offsetDir) * offset;
+
+	ai.velocity.x = sinf(facing) * MAX_VELOCITY;
+	ai.velocity.y = cosf(facing) * MAX_VELOCITY;
 
-		m_aiServerEntities[nextId].data = &ai;
-		m_aiServerEntities[nextId].wanderAngle = randf() * 3.14159f * 2;
+	ai.teleported = false;
+	ai.ticks = m_numMessagesSent;
 
-		ai.id = nextId++;
-		ai.position.x = sinf(offsetDir) * offset;
-		ai.position.y = cosf(offsetDir) * offset;
+	unsigned int handle = m_aiEntities.insert(ai);
+	if (handle == SLOT_INVALID_HANDLE)
+		return false;
 
-		ai.velocity.x = sinf(facing) * MAX_VELOCITY;
-		ai.velocity.y = cosf(facing) * MAX_VELOCITY;
-		
-		ai.ticks = 0;
+	AIEntity& entity = m_aiEntities[m_aiEntities.size() - 1];
+	entity.id = handle;
+
+	AIServerEntity server;
+	server.data = &entity;
+	server.wanderAngle = randf() * 3.14159f * 2;
+	server.rngState = wanderSeed(m_seed, handle);
+	m_aiServerEntities.push_back(server);
+
+	m_spawned.push_back(handle);
+	return true;
+}
+
+void Server::despawnAIEntity(unsigned int handle) {
+	size_t index = m_aiEntities.erase(handle);
+	if (index == SlotMap<AIEntity>::npos)
+		return;
+
+	// mirror the slot map moving its last entity into the hole
+	if (index != m_aiServerEntities.size() - 1) {
+		m_aiServerEntities[index] = m_aiServerEntities.back();
+		m_aiServerEntities[index].data = &m_aiEntities[index];
 	}
+	m_aiServerEntities.pop_back();
+
+	m_despawned.push_back(handle);
+}
+
+void Server::churnAIEntities(float deltaTime) {
+	m_churnAccumulator += m_churnRate * deltaTime;
+	while (m_churnAccumulator >= 1 && m_aiEntities.empty() == false) {
+		m_churnAccumulator -= 1;
+		despawnAIEntity(m_aiEntities.handleAt(rand() % m_aiEntities.size()));
+		spawnAIEntity();
+	}
+}
+
+void Server::writeEntityEvents(RakNet::BitStream& stream, const std::vector<unsigned int>& despawned,
+							   const std::vector<unsigned int>& spawned) {
+	stream.Write((RakNet::MessageID)GameMessages::ID_ENTITY_EVENTS);
+	stream.Write(m_numMessagesSent);
+
+	stream.Write((unsigned int)despawned.size());
+	for (unsigned int handle : despawned)
+		stream.Write(handle);
+
+	// an entity can be spawned and despawned again within the same tick
+	unsigned int spawnCount = 0;
+	for (unsigned int handle : spawned)
+		spawnCount += m_aiEntities.contains(handle) ? 1 : 0;
+
+	stream.Write(spawnCount);
+	for (unsigned int handle : spawned) {
+		if (const AIEntity* ai = m_aiEntities.find(handle))
+			stream.Write((const char*)ai, sizeof(AIEntity));
+	}
+}
+
+void Server::broadcastEntityEvents() {
+	if (m_spawned.empty() && m_despawned.empty())
+		return;
+
+	RakNet::BitStream stream;
+	writeEntityEvents(stream, m_despawned, m_spawned);
+
+	// membership must arrive, so it bypasses the faulty broadcast
+	m_peerInterface->Send(&stream, HIGH_PRIORITY, RELIABLE_ORDERED, 0, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
+
+	m_spawned.clear();
+	m_despawned.clear();
+}
+
+void Server::sendAllEntities(const RakNet::SystemAddress& address) {
+	std::vector<unsigned int> all(m_aiEntities.size());
+	for (size_t i = 0; i < all.size(); ++i)
+		all[i] = m_aiEntities.handleAt(i);
+
+	RakNet::BitStream stream;
+	writeEntityEvents(stream, std::vector<unsigned int>(), all);
+	m_peerInterface->Send(&stream, HIGH_PRIORITY, RELIABLE_ORDERED, 0, address, false);
 }
 
 void Server::updateAIEntities(float deltaTime) {
+	PROFILE_SCOPE("updateAIEntities");
 
 	//Update message index count
 	m_numMessagesSent++;
+	m_tickTime = RakNet::GetTime();
 
 	for (auto& ai : m_aiServerEntities) {
 
-		// jitter offset
-		ai.wanderAngle += (randf() * 2 - 1) * WANDER_JITTER;
+		updateWander(ai, m_arenaRadius, deltaTime);
 
-		AIVector f = ai.data->velocity;
-		f.normalise();
+		//Add message number index to entity for sanity check clinet side
+		ai.data->ticks = m_numMessagesSent;
+	}
 
-		// wander force
-		ai.data->velocity.x += sinf(ai.wanderAngle) * WANDER_RADIUS + f.x * WANDER_OFFSET;
-		ai.data->velocity.y += cosf(ai.wanderAngle) * WANDER_RADIUS + f.y * WANDER_OFFSET;
+	// co-simulating clients can't follow membership changes
+	if (m_coSimulate == false) {
+		churnAIEntities(deltaTime);
+		broadcastEntityEvents();
+	}
 
-		// truncate
-		if (ai.data->velocity.lengthSqr() > (MAX_VELOCITY * MAX_VELOCITY)) {
-			ai.data->velocity.normalise();
-			ai.data->velocity.x *= MAX_VELOCITY;
-			ai.data->velocity.y *= MAX_VELOCITY;
+	// co-simulating clients only need to verify their state every so often
+	if (m_coSimulate) {
+		if (m_numMessagesSent % CHECKSUM_INTERVAL == 0) {
+			RakNet::BitStream stream;
+			stream.Write((RakNet::MessageID)GameMessages::ID_SIMULATION_CHECKSUM);
+			stream.Write(m_numMessagesSent);
+			stream.Write(wanderChecksum(m_aiServerEntities.data(), m_aiServerEntities.size()));
+			// reliable, ordered after the state it checks, a lost one would leave clients unable to tell they've diverged
+			m_peerInterface->Send(&stream, HIGH_PRIORITY, RELIABLE_ORDERED, 0, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
 		}
+		return;
+	}
 
-		// move
-		ai.data->position.x += ai.data->velocity.x * deltaTime;
-		ai.data->position.y += ai.data->velocity.y * deltaTime;
-
-		ai.data->teleported = false;
-
-		// teleport if needed to stay in arena
-		if (ai.data->position.lengthSqr() > (m_arenaRadius * m_arenaRadius)) {
-			ai.data->teleported = true;
-			AIVector offset = ai.data->position;
-			offset.normalise();
-			ai.data->position.x -= offset.x * m_arenaRadius * 2;
-			ai.data->position.y -= offset.y * m_arenaRadius * 2;
-		}
-		
-		//Add message number index to entity for sanity check clinet side
-		ai.data->ticks = m_numMessagesSent;
+	if (m_residuals) {
+		broadcastSnapshots();
+		return;
 	}
 
 	// broadcast entities
-	broadcastFaultyData((const char*)m_aiEntities.data(), m_aiEntities.size() * sizeof(AIEntity));
+	RakNet::BitStream stream;
+	writeEntityList(stream, m_aiEntities.data(), m_aiEntities.size(), m_tickTime);
+	broadcastFaultyData(stream);
 }
 
 // application main, uses command line options
 void main(int argc, char* argv[]) {
 
-	std::cout << "Use command line options: -count N -radius M -loss X -delay Y -range Z" << std::endl;
+	std::cout << "Use command line options: -count N -radius M -loss X -delay Y -range Z [-cosim] [-seed S] [-residual] [-rangecoder] [-benchcodec T] [-churn C] [-profile]" << std::endl;
 	std::cout << "N: entity count as int" << std::endl;
 	std::cout << "M: arena radius as float" << std::endl;
 	std::cout << "X: packetloss percentage as float" << std::endl;
 	std::cout << "Y: packet delay percentage as float" << std::endl;
-	std::cout << "Z: delay range in seconds as float" << std::endl << std::endl;
+	std::cout << "Z: delay range in seconds as float" << std::endl;
+	std::cout << "-cosim: clients simulate the AI locally from a seed" << std::endl;
+	std::cout << "S: wander seed as int" << std::endl;
+	std::cout << "-residual: code entities against the client's prediction" << std::endl;
+	std::cout << "-rangecoder: range code residuals for clients that support it, implies -residual" << std::endl;
+	std::cout << "T: ticks to benchmark the snapshot formats over, then exit" << std::endl;
+	std::cout << "C: entities despawned and replaced per second as float, ignored with -cosim" << std::endl;
+	std::cout << "-profile: record hot path timings, kept in the rotating server_trace.N.json files" << std::endl << std::endl;
 
 	unsigned int entityCount = 100;
 	float radius = 50;
 	float packetlossPercentage = 10;
 	float delayPercentage = 10;
 	float delayRange = 1;
+	bool coSimulate = false;
+	unsigned int seed = 1;
+	bool residuals = false;
+	bool rangeCoding = false;
+	unsigned int benchmarkTicks = 0;
+	float churnRate = 0;
+	bool profile = false;
 
 	for (int i = 0; i < argc; ++i) {
 		if (strcmp(argv[i], "-count") == 0) {
@@ -239,14 +565,49 @@ void main(int argc, char* argv[]) {
 		if (strcmp(argv[i], "-range") == 0) {
 			delayRange = (float)atof(argv[i + 1]);
 		}
+		if (strcmp(argv[i], "-cosim") == 0) {
+			coSimulate = true;
+		}
+		if (strcmp(argv[i], "-seed") == 0) {
+			seed = (unsigned int)atoi(argv[i + 1]);
+		}
+		if (strcmp(argv[i], "-residual") == 0) {
+			residuals = true;
+		}
+		if (strcmp(argv[i], "-rangecoder") == 0) {
+			residuals = true;
+			rangeCoding = true;
+		}
+		if (strcmp(argv[i], "-benchcodec") == 0) {
+			benchmarkTicks = (unsigned int)atoi(argv[i + 1]);
+		}
+		if (strcmp(argv[i], "-churn") == 0) {
+			churnRate = (float)atof(argv[i + 1]);
+		}
+		if (strcmp(argv[i], "-profile") == 0) {
+			profile = true;
+		}
 	}
 
 	std::cout << "Entity Count: " << entityCount << std::endl;
 	std::cout << "Arena Radius: " << radius << std::endl;
 	std::cout << "Packet Loss Percentage: " << packetlossPercentage << std::endl;
 	std::cout << "Packet Delay Percentage: " << delayPercentage << std::endl;
-	std::cout << "Max Delay Time in Seconds: " << delayRange << std::endl << std::endl;
+	std::cout << "Max Delay Time in Seconds: " << delayRange << std::endl;
+	std::cout << "Co-Simulation: " << (coSimulate ? "on" : "off") << ", Seed: " << seed << std::endl;
+	std::cout << "Residual Snapshots: " << (residuals ? "on" : "off") << ", Range Coding: " << (rangeCoding ? "on" : "off") << std::endl;
+	std::cout << "Churn per Second: " << (coSimulate ? 0 : churnRate) << std::endl;
+	std::cout << "Profiling: " << (profile ? "on" : "off") << std::endl << std::endl;
+
+	// the last minute is always on disk, in six files of ten seconds
+	if (profile) {
+		Profiler::setEnabled(true);
+		Profiler::startRotating("server_trace", 10, 6);
+	}
 
-	Server server(entityCount, radius, packetlossPercentage, delayPercentage, delayRange);
-	server.run();
+	Server server(entityCount, radius, packetlossPercentage, delayPercentage, delayRange, coSimulate, seed, residuals, rangeCoding, churnRate);
+	if (benchmarkTicks > 0)
+		server.benchmarkCodecs(benchmarkTicks);
+	else
+		server.run();
 }
\ No newline at end of file
@@ -1,52 +1,113 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <vector>
+#include <list>
 #include <unordered_map>
 
 #include <RakPeerInterface.h>
 #include <BitStream.h>
 
 #include "../src/AIEntity.h"
+#include "../src/AIWander.h"
+#include "../src/EntityList.h"
+#include "../src/SlotMap.h"
+#include "../src/SnapshotCodec.h"
 
 class Server {
 public:
 
-	Server(unsigned int entityCount, float arenaRadius, float packetlossPercentage, float delayPercentage, float delayRange);
+	Server(unsigned int entityCount, float arenaRadius, float packetlossPercentage, float delayPercentage, float delayRange,
+		   bool coSimulate, unsigned int seed, bool residuals, bool rangeCoding, float churnRate);
 	~Server();
 
 	void	run();
+
+	// simulates without networking and reports encode / decode cost against bytes for each snapshot format
+	void	benchmarkCodecs(unsigned int ticks);
 			
 private:
 
 	//Number Of messages sent
 	unsigned int m_numMessagesSent;
+
+	// RakNet::GetTime when we stepped to m_numMessagesSent, snapshots carry it so clients can tell how stale they are
+	RakNet::Time m_tickTime;
 	
-	// occasionally loses or delays packets
-	void	broadcastFaultyData(const char* data, unsigned int size);
+	// occasionally loses or delays packets, sent to everyone unless an address is given
+	void	broadcastFaultyData(RakNet::BitStream& stream,
+								const RakNet::SystemAddress& address = RakNet::UNASSIGNED_SYSTEM_ADDRESS);
 
 	// sends stream immediately
-	void	sendBitStream(RakNet::BitStream* stream);
+	void	sendBitStream(RakNet::BitStream* stream, const RakNet::SystemAddress& address);
+
+	// sends each client the current entities in the best format it supports,
+	// residual formats are coded against the last snapshot that client acknowledged
+	void	broadcastSnapshots();
+
+	// sends the full wander state reliably to a co-simulating client
+	void	sendSimulationState(const RakNet::SystemAddress& address);
 
 	// set up / update AI data and broadcast
 	void	setupAIEntities(unsigned int count);
 	void	updateAIEntities(float deltaTime);
 
+	// adds an entity at a random position, returns false if there's no room left
+	bool	spawnAIEntity();
+	void	despawnAIEntity(unsigned int handle);
+
+	// replaces m_churnRate random entities a second with new ones
+	void	churnAIEntities(float deltaTime);
+
+	// sends this tick's spawns and despawns reliably to every client
+	void	broadcastEntityEvents();
+
+	// sends every live entity as a spawn, so a new client knows what snapshots refer to
+	void	sendAllEntities(const RakNet::SystemAddress& address);
+
+	// writes an ID_ENTITY_EVENTS message, spawned handles that no longer exist are skipped
+	void	writeEntityEvents(RakNet::BitStream& stream, const std::vector<unsigned int>& despawned,
+							  const std::vector<unsigned int>& spawned);
+
 	// helper method, returns random range [0,1]
 	static float	randf();
 
-	// wander data
+	// wander data, the wander constants live in AIWander.h
 	float		m_arenaRadius;
-	const float MAX_VELOCITY = 10;
-	const float WANDER_JITTER = 0.05f;
-	const float WANDER_OFFSET = 2.5f;
-	const float WANDER_RADIUS = 1.5f;
 
-	// this data is sent to clients
-	std::vector<AIEntity>		m_aiEntities;
+	// co-simulation, clients step the wander kernel themselves and
+	// only receive the seeded state, checksums and corrections
+	bool		m_coSimulate;
+	unsigned int m_seed;
+	const unsigned int CHECKSUM_INTERVAL = 30;
+
+	// residual snapshots, coded per client against what it has acknowledged
+	// and optionally range coded, if the client advertised support for it
+	bool				m_residuals;
+	bool				m_rangeCoding;
+	SnapshotHistory		m_snapshotHistory;
+
+	struct ClientConnection {
+		RakNet::SystemAddress	address;
+		unsigned int			ackedTick;
+		unsigned int			capabilities;
+	};
+	std::unordered_map<uint64_t, ClientConnection>	m_clients;
+
+	// this data is sent to clients, densely packed and keyed by generational handle
+	SlotMap<AIEntity>			m_aiEntities;
 
 	// this data is NOT sent to clients, handles wandering
+	// parallel to m_aiEntities' dense order, both are reserved up front so data pointers
+	// only change when a despawn moves an entity, which re-points it
 	std::vector<AIServerEntity>	m_aiServerEntities;
 
+	// entities replaced per second, and what changed this tick
+	float						m_churnRate;
+	float						m_churnAccumulator;
+	std::vector<unsigned int>	m_spawned;
+	std::vector<unsigned int>	m_despawned;
+
 	// raknet
 	const unsigned short PORT = 5456;
 	RakNet::RakPeerInterface*	m_peerInterface;
@@ -58,6 +119,7 @@ private:
 	
 	struct DelayedBroadcast {
 		double delayMicroseconds;
+		RakNet::SystemAddress address;
 		RakNet::BitStream stream;
 	};
 	std::list<DelayedBroadcast*>	m_delayedMessages;
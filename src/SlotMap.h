@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// handles are the slot index in the low bits and the slot's generation in the high bits,
+// so a handle to a removed value never matches whatever reuses its slot
+static const unsigned int SLOT_INDEX_BITS = 20;
+static const unsigned int SLOT_INDEX_MASK = (1u << SLOT_INDEX_BITS) - 1;
+static const unsigned int SLOT_INVALID_HANDLE = 0xffffffff;
+
+inline unsigned int slotIndex(unsigned int handle)		{ return handle & SLOT_INDEX_MASK; }
+inline unsigned int slotGeneration(unsigned int handle)	{ return handle >> SLOT_INDEX_BITS; }
+
+// generational slot map, values are packed densely for iteration and removal moves the
+// last value into the hole, all storage is allocated up front so nothing ever reallocates
+template <typename T>
+class SlotMap {
+public:
+
+	static const size_t npos = (size_t)-1;
+
+	SlotMap() {}
+	explicit SlotMap(size_t capacity) { reserve(capacity); }
+
+	// allocates storage for capacity values, only valid while empty
+	void	reserve(size_t capacity) {
+		if (capacity > SLOT_INDEX_MASK)
+			capacity = SLOT_INDEX_MASK;
+		m_values.reserve(capacity);
+		m_handles.reserve(capacity);
+		m_slots.reserve(capacity);
+		m_free.reserve(capacity);
+	}
+
+	size_t	capacity() const	{ return m_values.capacity(); }
+	size_t	size() const		{ return m_values.size(); }
+	bool	empty() const		{ return m_values.empty(); }
+	bool	full() const		{ return m_values.size() == m_values.capacity(); }
+
+	// returns the new value's handle, or SLOT_INVALID_HANDLE if the map is full
+	// the value is always appended, so its dense index is size() - 1
+	unsigned int	insert(const T& value) {
+		if (full())
+			return SLOT_INVALID_HANDLE;
+
+		unsigned int index;
+		if (m_free.empty()) {
+			index = (unsigned int)m_slots.size();
+			m_slots.push_back(Slot{ 0, 0 });
+		}
+		else {
+			index = m_free.back();
+			m_free.pop_back();
+		}
+
+		Slot& slot = m_slots[index];
+		slot.dense = (unsigned int)m_values.size();
+		unsigned int handle = (slot.generation << SLOT_INDEX_BITS) | index;
+
+		m_values.push_back(value);
+		m_handles.push_back(handle);
+		return handle;
+	}
+
+	// removes the value, returns the dense index it had (which the last value now occupies)
+	// so parallel arrays can mirror the move, or npos if the handle is stale
+	size_t	erase(unsigned int handle) {
+		size_t dense = indexOf(handle);
+		if (dense == npos)
+			return npos;
+
+		size_t last = m_values.size() - 1;
+		if (dense != last) {
+			m_values[dense] = m_values[last];
+			m_handles[dense] = m_handles[last];
+			m_slots[slotIndex(m_handles[dense])].dense = (unsigned int)dense;
+		}
+		m_values.pop_back();
+		m_handles.pop_back();
+
+		// bumping the generation is what makes old handles stale
+		Slot& slot = m_slots[slotIndex(handle)];
+		slot.generation = (slot.generation + 1) & (0xffffffff >> SLOT_INDEX_BITS);
+		m_free.push_back(slotIndex(handle));
+		return dense;
+	}
+
+	void	clear() {
+		while (m_values.empty() == false)
+			erase(m_handles.back());
+	}
+
+	// dense index of the value, or npos if the handle is stale
+	size_t	indexOf(unsigned int handle) const {
+		unsigned int index = slotIndex(handle);
+		if (index >= m_slots.size() || m_slots[index].generation != slotGeneration(handle))
+			return npos;
+		size_t dense = m_slots[index].dense;
+		return dense < m_handles.size() && m_handles[dense] == handle ? dense : npos;
+	}
+
+	bool		contains(unsigned int handle) const	{ return indexOf(handle) != npos; }
+
+	T*			find(unsigned int handle) {
+		size_t dense = indexOf(handle);
+		return dense != npos ? &m_values[dense] : nullptr;
+	}
+
+	// dense access, in no particular order
+	T*			data()								{ return m_values.data(); }
+	const T*	data() const						{ return m_values.data(); }
+	T&			operator[](size_t dense)			{ return m_values[dense]; }
+	const T&	operator[](size_t dense) const		{ return m_values[dense]; }
+	unsigned int	handleAt(size_t dense) const	{ return m_handles[dense]; }
+
+	typename std::vector<T>::iterator		begin()			{ return m_values.begin(); }
+	typename std::vector<T>::iterator		end()			{ return m_values.end(); }
+	typename std::vector<T>::const_iterator	begin() const	{ return m_values.begin(); }
+	typename std::vector<T>::const_iterator	end() const		{ return m_values.end(); }
+
+private:
+
+	struct Slot {
+		unsigned int dense;
+		unsigned int generation;
+	};
+
+	std::vector<T>				m_values;
+	std::vector<unsigned int>	m_handles;	// handle of each dense value
+	std::vector<Slot>			m_slots;
+	std::vector<unsigned int>	m_free;		// slot indices ready for reuse
+};
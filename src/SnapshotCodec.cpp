@@ -0,0 +1,281 @@
+#include "SnapshotCodec.h"
+#include "RangeCoder.h"
+#include <BitStream.h>
+#include <cmath>
+
+SnapshotHistory::SnapshotHistory() {
+	clear();
+}
+
+QuantizedSnapshot& SnapshotHistory::store(unsigned int tick) {
+	unsigned int slot = tick % SNAPSHOT_HISTORY;
+	m_valid[slot] = true;
+	m_snapshots[slot].tick = tick;
+	return m_snapshots[slot];
+}
+
+const QuantizedSnapshot* SnapshotHistory::find(unsigned int tick) const {
+	unsigned int slot = tick % SNAPSHOT_HISTORY;
+	if (m_valid[slot] && m_snapshots[slot].tick == tick)
+		return &m_snapshots[slot];
+	return nullptr;
+}
+
+void SnapshotHistory::clear() {
+	for (auto& valid : m_valid)
+		valid = false;
+}
+
+void SnapshotCodec::quantize(const AIEntity* entities, size_t count, unsigned int tick, RakNet::Time time,
+							 QuantizedSnapshot& out) {
+	out.tick = tick;
+	out.time = time;
+	out.entities.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		QuantizedEntity& q = out.entities[i];
+		q.id = entities[i].id;
+		q.px = (int)floorf(entities[i].position.x * SNAPSHOT_SCALE + 0.5f);
+		q.py = (int)floorf(entities[i].position.y * SNAPSHOT_SCALE + 0.5f);
+		q.vx = (int)floorf(entities[i].velocity.x * SNAPSHOT_SCALE + 0.5f);
+		q.vy = (int)floorf(entities[i].velocity.y * SNAPSHOT_SCALE + 0.5f);
+		q.teleported = entities[i].teleported;
+	}
+}
+
+void SnapshotCodec::dequantize(const QuantizedSnapshot& snapshot, std::vector<AIEntity>& out) {
+	out.resize(snapshot.entities.size());
+	for (size_t i = 0; i < out.size(); ++i) {
+		const QuantizedEntity& q = snapshot.entities[i];
+		out[i].id = q.id;
+		out[i].position.x = q.px / SNAPSHOT_SCALE;
+		out[i].position.y = q.py / SNAPSHOT_SCALE;
+		out[i].velocity.x = q.vx / SNAPSHOT_SCALE;
+		out[i].velocity.y = q.vy / SNAPSHOT_SCALE;
+		out[i].teleported = q.teleported;
+		out[i].ticks = snapshot.tick;
+	}
+}
+
+void SnapshotCodec::predict(const QuantizedEntity& baseline, unsigned int elapsedTicks, QuantizedEntity& out) {
+	// integer maths only, the client must arrive at exactly the same prediction
+	out = baseline;
+	out.px += (baseline.vx * (int)elapsedTicks) / 60;
+	out.py += (baseline.vy * (int)elapsedTicks) / 60;
+}
+
+void SnapshotCodec::makeResiduals(const QuantizedSnapshot& current, const QuantizedSnapshot* baseline,
+								  std::vector<unsigned int>& residuals) {
+	residuals.resize(current.entities.size() * SNAPSHOT_RESIDUAL_FIELDS);
+	unsigned int* out = residuals.data();
+
+	unsigned int expectedId = 0;
+	for (size_t i = 0; i < current.entities.size(); ++i) {
+		const QuantizedEntity& q = current.entities[i];
+
+		// ids normally follow on from the previous one, so this is usually zero
+		*out++ = zigzag((int)(q.id - expectedId));
+		*out++ = q.teleported ? 1 : 0;
+		expectedId = q.id + 1;
+
+		QuantizedEntity prediction = { q.id, 0, 0, 0, 0, false };
+		if (baseline != nullptr &&
+			i < baseline->entities.size() &&
+			baseline->entities[i].id == q.id)
+			predict(baseline->entities[i], current.tick - baseline->tick, prediction);
+
+		*out++ = zigzag(q.px - prediction.px);
+		*out++ = zigzag(q.py - prediction.py);
+		*out++ = zigzag(q.vx - prediction.vx);
+		*out++ = zigzag(q.vy - prediction.vy);
+	}
+}
+
+void SnapshotCodec::applyResiduals(const unsigned int* residuals, unsigned int count, unsigned int tick,
+								   const QuantizedSnapshot* baseline, QuantizedSnapshot& out) {
+	out.tick = tick;
+	out.entities.resize(count);
+
+	unsigned int expectedId = 0;
+	for (unsigned int i = 0; i < count; ++i, residuals += SNAPSHOT_RESIDUAL_FIELDS) {
+		QuantizedEntity& q = out.entities[i];
+
+		q.id = expectedId + unzigzag(residuals[0]);
+		expectedId = q.id + 1;
+
+		QuantizedEntity prediction = { q.id, 0, 0, 0, 0, false };
+		if (baseline != nullptr &&
+			i < baseline->entities.size() &&
+			baseline->entities[i].id == q.id)
+			predict(baseline->entities[i], tick - baseline->tick, prediction);
+
+		q.px = prediction.px + unzigzag(residuals[2]);
+		q.py = prediction.py + unzigzag(residuals[3]);
+		q.vx = prediction.vx + unzigzag(residuals[4]);
+		q.vy = prediction.vy + unzigzag(residuals[5]);
+		q.teleported = residuals[1] != 0;
+	}
+}
+
+void SnapshotCodec::writeHeader(RakNet::BitStream& stream, RakNet::MessageID id,
+								const QuantizedSnapshot& current, const QuantizedSnapshot* baseline) {
+	stream.Write(id);
+	stream.Write(current.tick);
+	stream.Write(current.time);
+	stream.Write(baseline != nullptr ? baseline->tick : SNAPSHOT_NO_BASELINE);
+	stream.Write((unsigned int)current.entities.size());
+}
+
+bool SnapshotCodec::readHeader(RakNet::BitStream& stream, const SnapshotHistory& history,
+							   unsigned int& tick, RakNet::Time& time, const QuantizedSnapshot*& baseline,
+							   unsigned int& count) {
+	unsigned int baselineTick = 0;
+	if (stream.Read(tick) == false ||
+		stream.Read(time) == false ||
+		stream.Read(baselineTick) == false ||
+		stream.Read(count) == false)
+		return false;
+
+	baseline = nullptr;
+	if (baselineTick != SNAPSHOT_NO_BASELINE) {
+		baseline = history.find(baselineTick);
+		if (baseline == nullptr)
+			return false;
+	}
+	return true;
+}
+
+void SnapshotCodec::writeResiduals(RakNet::BitStream& stream, const QuantizedSnapshot& current,
+								   const QuantizedSnapshot* baseline) {
+	thread_local std::vector<unsigned int> residuals;
+	makeResiduals(current, baseline, residuals);
+
+	writeHeader(stream, (RakNet::MessageID)GameMessages::ID_ENTITY_RESIDUALS, current, baseline);
+	for (unsigned int value : residuals)
+		writeVarint(stream, value);
+}
+
+bool SnapshotCodec::readResiduals(RakNet::BitStream& stream, const SnapshotHistory& history,
+								  QuantizedSnapshot& out) {
+	unsigned int tick = 0, count = 0;
+	RakNet::Time time = 0;
+	const QuantizedSnapshot* baseline = nullptr;
+	if (readHeader(stream, history, tick, time, baseline, count) == false)
+		return false;
+
+	// every value takes at least a byte, reject counts the packet can't hold
+	if (count > stream.GetNumberOfUnreadBits() / (8 * SNAPSHOT_RESIDUAL_FIELDS))
+		return false;
+
+	thread_local std::vector<unsigned int> residuals;
+	residuals.resize(count * SNAPSHOT_RESIDUAL_FIELDS);
+	for (auto& value : residuals) {
+		if (readVarint(stream, value) == false)
+			return false;
+	}
+
+	applyResiduals(residuals.data(), count, tick, baseline, out);
+	out.time = time;
+	return true;
+}
+
+// each field has its own models, picked by the size of the same field in the previous entity
+// since neighbouring entities tend to have similar residual magnitudes
+static const unsigned int RANGE_CONTEXTS_PER_FIELD = 3;
+
+static unsigned int rangeContext(unsigned int previous) {
+	if (previous == 0)
+		return 0;
+	return previous < 16 ? 1 : 2;
+}
+
+void SnapshotCodec::writeRangeResiduals(RakNet::BitStream& stream, const QuantizedSnapshot& current,
+										const QuantizedSnapshot* baseline) {
+	thread_local std::vector<unsigned int> residuals;
+	thread_local std::vector<unsigned char> coded;
+	makeResiduals(current, baseline, residuals);
+
+	// snapshots can be lost, so the models start fresh for every one
+	RangeIntegerModel models[SNAPSHOT_RESIDUAL_FIELDS * RANGE_CONTEXTS_PER_FIELD];
+	for (auto& model : models)
+		model.reset();
+
+	coded.clear();
+	RangeEncoder encoder(coded);
+	unsigned int previous[SNAPSHOT_RESIDUAL_FIELDS] = { 0 };
+	for (size_t i = 0; i < residuals.size(); i += SNAPSHOT_RESIDUAL_FIELDS) {
+		for (unsigned int field = 0; field < SNAPSHOT_RESIDUAL_FIELDS; ++field) {
+			unsigned int value = residuals[i + field];
+			encoder.encodeInteger(models[field * RANGE_CONTEXTS_PER_FIELD + rangeContext(previous[field])], value);
+			previous[field] = value;
+		}
+	}
+	encoder.flush();
+
+	writeHeader(stream, (RakNet::MessageID)GameMessages::ID_ENTITY_RESIDUALS_RANGE, current, baseline);
+	stream.Write((unsigned int)coded.size());
+	stream.Write((const char*)coded.data(), (unsigned int)coded.size());
+}
+
+bool SnapshotCodec::readRangeResiduals(RakNet::BitStream& stream, const SnapshotHistory& history,
+									   QuantizedSnapshot& out) {
+	unsigned int tick = 0, count = 0, size = 0;
+	RakNet::Time time = 0;
+	const QuantizedSnapshot* baseline = nullptr;
+	if (readHeader(stream, history, tick, time, baseline, count) == false ||
+		stream.Read(size) == false ||
+		size > BITS_TO_BYTES(stream.GetNumberOfUnreadBits()))
+		return false;
+
+	// even with fully adapted models an entity costs over half a bit, reject counts the data can't hold
+	if (count > size * 16)
+		return false;
+
+	// the coded bytes are read in place, the stream is byte aligned after the header
+	const unsigned char* data = stream.GetData() + BITS_TO_BYTES(stream.GetReadOffset());
+	stream.IgnoreBytes(size);
+
+	RangeIntegerModel models[SNAPSHOT_RESIDUAL_FIELDS * RANGE_CONTEXTS_PER_FIELD];
+	for (auto& model : models)
+		model.reset();
+
+	thread_local std::vector<unsigned int> residuals;
+	residuals.resize(count * SNAPSHOT_RESIDUAL_FIELDS);
+
+	RangeDecoder decoder(data, size);
+	unsigned int previous[SNAPSHOT_RESIDUAL_FIELDS] = { 0 };
+	for (size_t i = 0; i < residuals.size(); i += SNAPSHOT_RESIDUAL_FIELDS) {
+		for (unsigned int field = 0; field < SNAPSHOT_RESIDUAL_FIELDS; ++field) {
+			unsigned int value = decoder.decodeInteger(models[field * RANGE_CONTEXTS_PER_FIELD + rangeContext(previous[field])]);
+			residuals[i + field] = value;
+			previous[field] = value;
+		}
+	}
+	if (decoder.overrun())
+		return false;
+
+	applyResiduals(residuals.data(), count, tick, baseline, out);
+	out.time = time;
+	return true;
+}
+
+void SnapshotCodec::writeVarint(RakNet::BitStream& stream, unsigned int value) {
+	while (value >= 0x80) {
+		stream.Write((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	stream.Write((unsigned char)value);
+}
+
+bool SnapshotCodec::readVarint(RakNet::BitStream& stream, unsigned int& value) {
+	value = 0;
+	for (unsigned int shift = 0; shift < 35; shift += 7) {
+		unsigned char byte = 0;
+		if (stream.Read(byte) == false)
+			return false;
+		value |= (unsigned int)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	// more than 5 bytes can't be a 32 bit value
+	return false;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "AIEntity.h"
+#include <RakNetTypes.h>
+#include <vector>
+
+namespace RakNet {
+	class BitStream;
+}
+
+// entity state in fixed point, both sides predict and reconstruct in these units
+// so the client rebuilds exactly the values the server encoded against
+static const int SNAPSHOT_PRECISION_BITS = 8;
+static const float SNAPSHOT_SCALE = (float)(1 << SNAPSHOT_PRECISION_BITS);
+
+// number of past snapshots either side keeps to use as a baseline
+static const unsigned int SNAPSHOT_HISTORY = 64;
+
+// baseline tick written when a snapshot is coded against nothing
+static const unsigned int SNAPSHOT_NO_BASELINE = 0xffffffff;
+
+// residual fields per entity: id delta, teleported, px, py, vx, vy
+// the id delta takes all 32 bits once generations are high, so teleported can't share it
+static const unsigned int SNAPSHOT_RESIDUAL_FIELDS = 6;
+
+// capabilities a client advertises with ID_CLIENT_CAPABILITIES
+enum SnapshotCapabilities {
+	CAPABILITY_RESIDUALS = 1 << 0,
+	CAPABILITY_RANGE_CODING = 1 << 1,
+};
+
+struct QuantizedEntity {
+	unsigned int id;
+	int px, py;
+	int vx, vy;
+	bool teleported;
+};
+
+struct QuantizedSnapshot {
+	unsigned int tick;
+	RakNet::Time time;	// the server's RakNet::GetTime when it stepped to tick
+	std::vector<QuantizedEntity> entities;
+};
+
+// ring of recent snapshots indexed by tick
+class SnapshotHistory {
+public:
+
+	SnapshotHistory();
+
+	// returns the slot to fill for the given tick, evicting whatever was there
+	QuantizedSnapshot&			store(unsigned int tick);
+
+	// returns nullptr if the tick has been evicted or was never stored
+	const QuantizedSnapshot*	find(unsigned int tick) const;
+
+	void						clear();
+
+private:
+
+	QuantizedSnapshot	m_snapshots[SNAPSHOT_HISTORY];
+	bool				m_valid[SNAPSHOT_HISTORY];
+};
+
+class SnapshotCodec {
+public:
+
+	static void		quantize(const AIEntity* entities, size_t count, unsigned int tick, RakNet::Time time,
+							 QuantizedSnapshot& out);
+	static void		dequantize(const QuantizedSnapshot& snapshot, std::vector<AIEntity>& out);
+
+	// the client's extrapolator, moving the baseline forward by the elapsed ticks
+	static void		predict(const QuantizedEntity& baseline, unsigned int elapsedTicks, QuantizedEntity& out);
+
+	// codes each entity as the difference between its state and the prediction from the
+	// baseline (or absolute if there is no baseline), SNAPSHOT_RESIDUAL_FIELDS values per entity
+	static void		makeResiduals(const QuantizedSnapshot& current, const QuantizedSnapshot* baseline,
+								  std::vector<unsigned int>& residuals);
+	static void		applyResiduals(const unsigned int* residuals, unsigned int count, unsigned int tick,
+								   const QuantizedSnapshot* baseline, QuantizedSnapshot& out);
+
+	// writes an ID_ENTITY_RESIDUALS message, residuals as varints
+	static void		writeResiduals(RakNet::BitStream& stream, const QuantizedSnapshot& current,
+								   const QuantizedSnapshot* baseline);
+
+	// writes an ID_ENTITY_RESIDUALS_RANGE message, residuals through the adaptive range coder
+	static void		writeRangeResiduals(RakNet::BitStream& stream, const QuantizedSnapshot& current,
+										const QuantizedSnapshot* baseline);
+
+	// read either message (past the message ID)
+	// returns false if the baseline it was coded against is not in the history or the data is bad
+	static bool		readResiduals(RakNet::BitStream& stream, const SnapshotHistory& history,
+								  QuantizedSnapshot& out);
+	static bool		readRangeResiduals(RakNet::BitStream& stream, const SnapshotHistory& history,
+									   QuantizedSnapshot& out);
+
+	// variable-length integers, 7 bits per byte, small magnitudes take a single byte
+	static void		writeVarint(RakNet::BitStream& stream, unsigned int value);
+	static bool		readVarint(RakNet::BitStream& stream, unsigned int& value);
+
+	static unsigned int	zigzag(int value)			{ return ((unsigned int)value << 1) ^ (unsigned int)(value >> 31); }
+	static int			unzigzag(unsigned int value)	{ return (int)(value >> 1) ^ -(int)(value & 1); }
+
+private:
+
+	static void		writeHeader(RakNet::BitStream& stream, RakNet::MessageID id,
+								const QuantizedSnapshot& current, const QuantizedSnapshot* baseline);
+	static bool		readHeader(RakNet::BitStream& stream, const SnapshotHistory& history,
+							   unsigned int& tick, RakNet::Time& time, const QuantizedSnapshot*& baseline,
+							   unsigned int& count);
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+
+// lock-free handoff of the newest value from one producer thread to one consumer thread
+// the producer always has a buffer to write and the consumer always has one to read,
+// anything published twice before the consumer acquires it is simply overwritten
+template <typename T>
+class TripleBuffer {
+public:
+
+	TripleBuffer() : m_write(0), m_ready(1), m_read(2) {}
+
+	// producer side
+	T&			writeBuffer()		{ return m_buffers[m_write]; }
+
+	// hands the write buffer to the consumer, returns true if that dropped a value it never acquired
+	bool		publish() {
+		unsigned int previous = m_ready.exchange(m_write | FRESH);
+		m_write = previous & INDEX;
+		return (previous & FRESH) != 0;
+	}
+
+	// consumer side, returns false if nothing new has been published since the last acquire
+	bool		acquire() {
+		if ((m_ready.load() & FRESH) == 0)
+			return false;
+		m_read = m_ready.exchange(m_read) & INDEX;
+		return true;
+	}
+
+	T&			readBuffer()		{ return m_buffers[m_read]; }
+
+	// every buffer, only safe once neither thread is using them, e.g. to clean up on shutdown
+	static const unsigned int COUNT = 3;
+	T&			buffer(unsigned int index)	{ return m_buffers[index]; }
+
+private:
+
+	static const unsigned int INDEX = 3;
+	static const unsigned int FRESH = 4;
+
+	T							m_buffers[COUNT];
+	unsigned int				m_write;
+	std::atomic<unsigned int>	m_ready;
+	unsigned int				m_read;
+};